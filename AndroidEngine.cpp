@@ -24,6 +24,7 @@
 #include "AndroidAssetService.hpp"
 #include "AndroidSoundService.hpp"
 #include "ControllerService.hpp"
+#include "Program.hpp"
 #include "Ruine.hpp"
 #include "TypesToOStream.hpp"
 #include "mathutils.hpp"
@@ -90,6 +91,10 @@ namespace Soleil {
       std::make_unique<AndroidAssetService>(androidApp->activity->assetManager);
     SoundService::Instance =
       std::make_unique<AndroidSoundService>(AssetService::Instance.get());
+    if (androidApp->activity->internalDataPath) {
+      Program::BinaryCacheDirectory =
+        toString(androidApp->activity->internalDataPath, "/programs/");
+    }
 
     while (inProgress) {
       int                         ident;
@@ -21,7 +21,9 @@
 
 #include "AssetService.hpp"
 
+#include "Ktx.hpp"
 #include "Logger.hpp"
+#include "StateCache.hpp"
 #include "stringutils.hpp"
 
 #include <cassert>
@@ -77,24 +79,67 @@ namespace Soleil {
   void AssetService::LoadTextureHigh(GLuint             texture,
                                      const std::string& assetName)
   {
-    const ImageAsset image(assetName);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    gl::State().bindTexture(GL_TEXTURE_2D, texture);
+    if (LoadCompressedTexture(assetName, true) == false) {
+      const ImageAsset image(assetName);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+      glGenerateMipmap(GL_TEXTURE_2D);
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
   }
 
   void AssetService::LoadTextureLow(GLuint             texture,
                                     const std::string& assetName)
   {
-    const ImageAsset image(assetName);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    gl::State().bindTexture(GL_TEXTURE_2D, texture);
+    if (LoadCompressedTexture(assetName, false) == false) {
+      const ImageAsset image(assetName);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   }
 
+  bool AssetService::LoadCompressedTexture(const std::string& assetName,
+                                           const bool         mipmaps)
+  {
+    const GLenum format = gl::GetExtensions().etc1Format;
+    if (format == 0) return false;
+
+    const std::string ktxAsset =
+      assetName.substr(0, assetName.rfind('.')) + ".ktx";
+    std::vector<uint8_t> content;
+    try {
+      content = LoadAsDataVector(ktxAsset);
+    } catch (const std::runtime_error&) {
+      // The compressed version is optional
+      return false;
+    }
+
+    KtxTexture ktx;
+    if (KtxTexture::Deserialize(content, ktx) == false ||
+        ktx.internalFormat != GL_ETC1_RGB8_OES || ktx.levels.empty()) {
+      Logger::warning(toString("Invalid texture '", ktxAsset,
+                               "', loading the image instead"));
+      return false;
+    }
+
+    const std::size_t levels = mipmaps ? ktx.levels.size() : 1;
+    for (std::size_t i = 0; i < levels; ++i) {
+      const KtxTexture::Level& level = ktx.levels[i];
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, format, level.width,
+                             level.height, 0, level.data.size(),
+                             level.data.data());
+    }
+    throwOnGlError();
+    SOLEIL__LOGGER_DEBUG(toString("Loaded texture: ", ktxAsset, " -> ",
+                                  ktx.levels[0].width, "x",
+                                  ktx.levels[0].height, ", ", levels,
+                                  " levels"));
+    return true;
+  }
+
 } // Soleil
@@ -95,6 +95,15 @@ namespace Soleil {
     static std::vector<uint8_t> LoadAsDataVector(const std::string& assetName);
     static void LoadTextureHigh(GLuint texture, const std::string& assetName);
     static void LoadTextureLow(GLuint texture, const std::string& assetName);
+
+    /**
+     * Upload the ETC1 version of the image (name.ktx for name.png, see
+     * ktxBaker) to the bound texture, with its mip chain if mipmaps is set.
+     * Return false if there is none or the context cannot read it, the image
+     * is then to be loaded from its PNG.
+     */
+    static bool LoadCompressedTexture(const std::string& assetName,
+                                      const bool         mipmaps);
   };
 
 } // Soleil
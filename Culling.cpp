@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Culling.hpp"
+
+#include <algorithm>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace Soleil {
+
+  Frustum Frustum::FromViewProjection(const glm::mat4& m) noexcept
+  {
+    // Rows of the column-major matrix
+    const glm::vec4 x(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 y(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 z(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = w + x;
+    frustum.planes[1] = w - x;
+    frustum.planes[2] = w + y;
+    frustum.planes[3] = w - y;
+    frustum.planes[4] = w + z;
+    frustum.planes[5] = w - z;
+    return frustum;
+  }
+
+  void BoxArray::push(const BoundingBox& box)
+  {
+    const glm::vec3& min = box.getMin();
+    const glm::vec3& max = box.getMax();
+
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+  }
+
+  void BoxArray::erase(const std::size_t index)
+  {
+    minX.erase(minX.begin() + index);
+    minY.erase(minY.begin() + index);
+    minZ.erase(minZ.begin() + index);
+    maxX.erase(maxX.begin() + index);
+    maxY.erase(maxY.begin() + index);
+    maxZ.erase(maxZ.begin() + index);
+  }
+
+  void BoxArray::clear(void) noexcept
+  {
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+  }
+
+  BoundingBox BoxArray::get(const std::size_t index) const noexcept
+  {
+    return BoundingBox(glm::vec3(minX[index], minY[index], minZ[index]),
+                       glm::vec3(maxX[index], maxY[index], maxZ[index]));
+  }
+
+  std::size_t BoxArray::cull(const Frustum&             frustum,
+                             std::vector<std::uint8_t>& visible) const
+  {
+    const std::size_t count = size();
+
+    visible.assign(count, 1);
+    std::uint8_t* out = visible.data();
+    for (const glm::vec4& plane : frustum.planes) {
+      // The corner of each box the farthest along the plane normal is chosen
+      // once per plane, leaving the loop without branches.
+      const float* xs = (plane.x >= 0.0f) ? maxX.data() : minX.data();
+      const float* ys = (plane.y >= 0.0f) ? maxY.data() : minY.data();
+      const float* zs = (plane.z >= 0.0f) ? maxZ.data() : minZ.data();
+      const float  a  = plane.x;
+      const float  b  = plane.y;
+      const float  c  = plane.z;
+      const float  d  = plane.w;
+
+      for (std::size_t i = 0; i < count; ++i) {
+        out[i] &= static_cast<std::uint8_t>(a * xs[i] + b * ys[i] +
+                                              c * zs[i] + d >=
+                                            0.0f);
+      }
+    }
+    return static_cast<std::size_t>(
+      std::count(visible.begin(), visible.end(), 1));
+  }
+
+  // Same as in flatshape.vert
+  static constexpr float ConstantAttenuation = 0.1f;
+
+  constexpr int LightSet::Max;
+
+  float LightAttenuation(const PointLight& light,
+                         const float       distance) noexcept
+  {
+    return 1.0f / (ConstantAttenuation + light.linear * distance +
+                   light.quadratic * distance * distance);
+  }
+
+  int LightSet::size(void) const noexcept
+  {
+    int count = 0;
+    while (count < Max && (*this)[count] != 0xFFFF) ++count;
+    return count;
+  }
+
+  LightSet LightSet::Select(const BoundingBox&             bounds,
+                            const std::vector<PointLight>& lights,
+                            const float                    minInfluence)
+  {
+    struct Candidate
+    {
+      float         influence;
+      std::uint16_t index;
+    };
+    Candidate best[Max];
+    int       count = 0;
+
+    const std::size_t last = std::min<std::size_t>(lights.size(), 0xFFFF);
+    for (std::size_t i = 0; i < last; ++i) {
+      const PointLight& light = lights[i];
+      const glm::vec3   closest =
+        glm::clamp(light.position, bounds.getMin(), bounds.getMax());
+      const float distance  = glm::length(light.position - closest);
+      const float influence =
+        glm::max(light.color.r, glm::max(light.color.g, light.color.b)) *
+        LightAttenuation(light, distance);
+      if (influence < minInfluence) continue;
+
+      // Insertion in the few best, strongest first
+      int slot = count;
+      if (count < Max)
+        count++;
+      else if (influence <= best[Max - 1].influence)
+        continue;
+      else
+        slot = Max - 1;
+      for (; slot > 0 && best[slot - 1].influence < influence; --slot)
+        best[slot] = best[slot - 1];
+      best[slot] = {influence, static_cast<std::uint16_t>(i)};
+    }
+
+    std::sort(best, best + count, [](const Candidate& a, const Candidate& b) {
+      return a.index < b.index;
+    });
+
+    LightSet set;
+    for (int i = 0; i < count; ++i) {
+      set.packed &= ~(std::uint64_t(0xFFFF) << (16 * i));
+      set.packed |= std::uint64_t(best[i].index) << (16 * i);
+    }
+    return set;
+  }
+
+} // Soleil
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SOLEIL__CULLING_HPP_
+#define SOLEIL__CULLING_HPP_
+
+#include "BoundingBox.hpp"
+#include "types.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Soleil {
+
+  /**
+   * The six planes of a view frustum, pointing inside.
+   */
+  struct Frustum
+  {
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    /**
+     * Extract the planes of a View * Projection matrix (Gribb & Hartmann).
+     */
+    static Frustum FromViewProjection(const glm::mat4& viewProjection) noexcept;
+  };
+
+  /**
+   * Axis-aligned boxes stored as one array per coordinate, so a frustum can be
+   * tested against all of them in a single straight loop.
+   */
+  class BoxArray
+  {
+  public:
+    void push(const BoundingBox& box);
+    void erase(const std::size_t index);
+    void clear(void) noexcept;
+
+    std::size_t size(void) const noexcept { return minX.size(); }
+    BoundingBox get(const std::size_t index) const noexcept;
+
+    /**
+     * Set visible[i] to 1 if the box i is at least partly inside the
+     * frustum, to 0 otherwise. Return the number of visible boxes.
+     *
+     * Boxes crossing a corner of the frustum may be reported visible.
+     */
+    std::size_t cull(const Frustum&             frustum,
+                     std::vector<std::uint8_t>& visible) const;
+
+  private:
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+  };
+
+  /**
+   * Attenuation of the light at the distance, as in flatshape.vert
+   */
+  float LightAttenuation(const PointLight& light,
+                         const float       distance) noexcept;
+
+  /**
+   * The point lights lighting one draw: up to Max indices in
+   * Frame::pointLights, in increasing order. Two draws lit by the same lights
+   * have equal sets.
+   */
+  class LightSet
+  {
+  public:
+    static constexpr int Max = 4;
+
+    LightSet(void) noexcept
+      : packed(~std::uint64_t(0))
+    {
+    }
+
+    int           size(void) const noexcept;
+    std::uint16_t operator[](const int i) const noexcept
+    {
+      return (packed >> (16 * i)) & 0xFFFF;
+    }
+
+    bool operator==(const LightSet& other) const noexcept
+    {
+      return packed == other.packed;
+    }
+    bool operator!=(const LightSet& other) const noexcept
+    {
+      return packed != other.packed;
+    }
+    bool operator<(const LightSet& other) const noexcept
+    {
+      return packed < other.packed;
+    }
+
+    /**
+     * Keep the Max lights bringing the most light to the closest point of the
+     * box, with the attenuation of the shaders. Lights adding less than
+     * minInfluence to a color component are left out.
+     */
+    static LightSet Select(const BoundingBox&             bounds,
+                           const std::vector<PointLight>& lights,
+                           const float                    minInfluence);
+
+  private:
+    std::uint64_t packed; // 16 bits per index, unused ones are all set
+  };
+
+} // Soleil
+
+#endif /* SOLEIL__CULLING_HPP_ */
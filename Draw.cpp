@@ -21,8 +21,10 @@
 
 #include "Draw.hpp"
 
-#include "ControllerService.hpp"
 #include "OpenGLDataInstance.hpp"
+#include "StateCache.hpp"
+
+#include <algorithm>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -33,153 +35,285 @@ namespace Soleil {
                  const glm::vec4& color)
   {
     throwOnGlError();
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl::State().disable(GL_DEPTH_TEST);
+    gl::State().enable(GL_BLEND);
+    gl::State().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     throwOnGlError();
 
     const OpenGLDataInstance& ogl = OpenGLDataInstance::Instance();
     throwOnGlError();
 
-    glUseProgram(ogl.imageProgram.program);
-    throwOnGlError();
-    glBindBuffer(GL_ARRAY_BUFFER, *(ogl.imageBuffer));
+    gl::State().useProgram(ogl.imageProgram.program);
     throwOnGlError();
-
-    constexpr GLsizei stride = sizeof(GLfloat) * 2;
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
-    glEnableVertexAttribArray(0);
+    if (*ogl.imageVertexArray)
+      gl::GlBindVertexArray(*ogl.imageVertexArray);
+    else {
+      gl::State().bindBuffer(GL_ARRAY_BUFFER, *(ogl.imageBuffer));
+      SetImageVertexAttributes();
+    }
     throwOnGlError();
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glUniform1i(ogl.imageImage, 0);
+    gl::State().activeTexture(GL_TEXTURE0);
+    gl::State().bindTexture(GL_TEXTURE_2D, texture);
+    gl::State().uniform(ogl.imageImage, 0);
 
     glUniformMatrix4fv(ogl.imageModelMatrix, 1, GL_FALSE,
                        glm::value_ptr(transformation));
-    glUniform4fv(ogl.imageColor, 1, glm::value_ptr(color));
+    gl::State().uniform(ogl.imageColor, color);
     throwOnGlError();
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    gl::GlBindVertexArray(0);
     throwOnGlError();
   }
 
-  void DrawText(const TextCommand& textCommand, const glm::mat4& transformation,
+  /**
+   * Append the quads to the TextStream, whose vertex buffer is bound, and
+   * return their byte offset. At most TextStream::MaxQuads.
+   */
+  static GLintptr StreamQuads(TextStream& stream, const CharVertex* vertices,
+                              const std::size_t quads)
+  {
+    const GLsizeiptr bytes = sizeof(CharVertex) * 4 * quads;
+    if (stream.head + bytes > TextStream::Size) {
+      // Orphaned: the draws in flight keep the former storage
+      glBufferData(GL_ARRAY_BUFFER, TextStream::Size, nullptr, GL_STREAM_DRAW);
+      stream.head = 0;
+      stream.generation++;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, stream.head, bytes, vertices);
+
+    const GLintptr offset = stream.head;
+    stream.head += bytes;
+    return offset;
+  }
+
+  /**
+   * Draw the quads streamed at offset with the quad elements
+   */
+  static void DrawStreamedQuads(const GLintptr offset, const std::size_t quads)
+  {
+    SetCharVertexAttributes(offset);
+    glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT,
+                   (const GLvoid*)0);
+  }
+
+  void DrawText(TextCommand& textCommand, const glm::mat4& transformation,
                 const glm::vec4& color)
   {
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (textCommand.quads == nullptr || textCommand.quads->empty()) return;
 
-    const OpenGLDataInstance& ogl = OpenGLDataInstance::Instance();
+    gl::State().disable(GL_DEPTH_TEST);
+    gl::State().enable(GL_BLEND);
+    gl::State().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    glUseProgram(ogl.textProgram.program);
-    glBindBuffer(GL_ARRAY_BUFFER, *textCommand.buffer);
+    OpenGLDataInstance& ogl    = OpenGLDataInstance::Instance();
+    TextStream&         stream = ogl.textStream;
+
+    gl::State().useProgram(ogl.textProgram.program);
+    gl::GlBindVertexArray(0);
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, *stream.vertices);
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *stream.quadElements);
+
+    gl::State().activeTexture(GL_TEXTURE0);
+    gl::State().bindTexture(GL_TEXTURE_2D, *(ogl.textDefaultFontAtlas));
+    gl::State().uniform(ogl.textTexture, 0);
+
+    glUniformMatrix4fv(ogl.textModelMatrix, 1, GL_FALSE,
+                       glm::value_ptr(transformation));
+
+    gl::State().uniform(ogl.textColor, color);
+
+    if (ogl.textAtlas.distanceRange > 0.0f) {
+      // Blend the outline over about one pixel of the screen
+      const float pixelsPerTexel = textCommand.em *
+                                   ogl.textAtlas.pixelsPerTexel *
+                                   glm::length(glm::vec3(transformation[0]));
+      gl::State().uniform(ogl.textSmoothing,
+                          0.25f / (ogl.textAtlas.distanceRange *
+                                   std::max(pixelsPerTexel, 0.01f)));
+    }
+
+    const CharVertex* vertices = textCommand.quads->data();
+    const std::size_t quads    = textCommand.quads->size() / 4;
+    if (quads <= TextStream::MaxQuads) {
+      // Streamed again only once the stream was orphaned
+      if (textCommand.streamGeneration != stream.generation) {
+        textCommand.streamOffset     = StreamQuads(stream, vertices, quads);
+        textCommand.streamGeneration = stream.generation;
+      }
+      DrawStreamedQuads(textCommand.streamOffset, quads);
+    } else {
+      // Larger than the stream: streamed at each draw, by chunks
+      for (std::size_t first = 0; first < quads;
+           first += TextStream::MaxQuads) {
+        const std::size_t count =
+          std::min<std::size_t>(quads - first, TextStream::MaxQuads);
+        DrawStreamedQuads(StreamQuads(stream, vertices + first * 4, count),
+                          count);
+      }
+    }
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    throwOnGlError();
+  }
 
-    const GLsizei stride = sizeof(CharVertex);
+  void SetCharVertexAttributes(const GLintptr offset)
+  {
+    constexpr GLsizei stride = sizeof(CharVertex);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                          (const GLvoid*)offset);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
-                          (const GLvoid*)offsetof(CharVertex, uv));
+                          (const GLvoid*)(offset + offsetof(CharVertex, uv)));
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
+  }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, *(ogl.textDefaultFontAtlas));
-    glUniform1i(ogl.textTexture, 0);
-
-    glUniformMatrix4fv(ogl.textModelMatrix, 1, GL_FALSE,
-                       glm::value_ptr(transformation));
+  /**
+   * Bind the buffers of the Shape and point the vertex attributes to the
+   * SubShape, at once with its vertex array object when available.
+   */
+  static void BindSubShape(const Shape& shape, const SubShapeRange& range)
+  {
+    // The value of a disabled attribute is not part of the vertex array
+    if ((range.format & VertexFormat::Color) == 0)
+      gl::State().vertexAttrib(2, range.color);
 
-    glUniform4fv(ogl.textColor, 1, glm::value_ptr(color));
+    if (range.vertexArray) {
+      gl::GlBindVertexArray(range.vertexArray);
+      return;
+    }
 
-    glDrawElements(GL_TRIANGLES, textCommand.elements.size(), GL_UNSIGNED_SHORT,
-                   textCommand.elements.data());
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, shape.getBuffer());
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, shape.getIndexBuffer());
+    SetVertexAttributes(range);
     throwOnGlError();
   }
 
+  static void UnbindShapeBuffers(void)
+  {
+    gl::GlBindVertexArray(0);
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+
+  /**
+   * Draw the indices of the SubShape with the vertex attributes set
+   */
+  static void DrawSubShape(const SubShapeRange& range)
+  {
+    glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT,
+                   (const GLvoid*)range.indexOffset);
+  }
+
+  /**
+   * World space box of the shape, around its eight transformed corners
+   */
+  static BoundingBox WorldBounds(const Shape&     shape,
+                                 const glm::mat4& transformation)
+  {
+    const glm::vec3& min = shape.getBounds().getMin();
+    const glm::vec3& max = shape.getBounds().getMax();
+    BoundingBox      box;
+
+    for (int corner = 0; corner < 8; ++corner) {
+      const glm::vec4 point((corner & 1) ? max.x : min.x,
+                            (corner & 2) ? max.y : min.y,
+                            (corner & 4) ? max.z : min.z, 1.0f);
+      box.expandBy(glm::vec3(transformation * point));
+    }
+    return box;
+  }
+
+  static LightSet SelectLights(const BoundingBox& bounds, const Frame& frame)
+  {
+    return LightSet::Select(bounds, frame.pointLights,
+                            gval::lightInfluenceMin);
+  }
+
+  static LightSet SelectLights(const Shape&     shape,
+                               const glm::mat4& transformation,
+                               const Frame&     frame)
+  {
+    return SelectLights(WorldBounds(shape, transformation), frame);
+  }
+
+  /**
+   * Blend the translucent materials only, see MaterialFeature::AlphaBlend
+   */
+  static void SetMaterialBlending(const Material& material)
+  {
+    if (material.features & MaterialFeature::AlphaBlend) {
+      gl::State().enable(GL_BLEND);
+      gl::State().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+      gl::State().disable(GL_BLEND);
+    }
+  }
+
   void RenderPhongShape(const RenderInstances& instances, const Frame& frame)
   {
     throwOnGlError();
-    constexpr GLsizei         stride    = sizeof(Vertex);
     const OpenGLDataInstance& instance  = OpenGLDataInstance::Instance();
     const Program&            rendering = instance.drawable;
-    glUseProgram(rendering.program);
+    gl::State().useProgram(rendering.program);
 
     // Setting Lights
     // ----------------------------------------------------------
-    glUniform3fv(instance.drawableAmbiantLight, 1,
-                 glm::value_ptr(glm::vec3(.05f)));
+    gl::State().uniform(instance.drawableAmbiantLight, glm::vec3(.05f));
 
-    glUniform3fv(instance.drawableEyeDirection, 1,
-                 glm::value_ptr(frame.cameraPosition));
-    glUniform1i(instance.drawableNumberOfLights, frame.pointLights.size());
+    gl::State().uniform(instance.drawableEyeDirection, frame.cameraPosition);
     throwOnGlError();
 
-    int i = 0;
-    for (const auto& pointLight : frame.pointLights) {
-      // TODO: Protect to avoid array verflow
-
-      glUniform3fv(instance.drawablePointLights[i].position, 1,
-                   glm::value_ptr(pointLight.position));
-      glUniform3fv(instance.drawablePointLights[i].color, 1,
-                   glm::value_ptr(pointLight.color));
-      glUniform1f(instance.drawablePointLights[i].linearAttenuation, 0.7f);
-      glUniform1f(instance.drawablePointLights[i].quadraticAttenuation,
-                  0.2f);
-
-      ++i;
-    }
-
     for (const auto& drawCommand : instances) {
+      const Shape&   shape  = *drawCommand.shape;
+      const LightSet lights = SelectLights(shape, drawCommand.transformation,
+                                           frame);
+
+      gl::State().uniform(instance.drawableNumberOfLights, lights.size());
+      for (int i = 0; i < lights.size(); ++i) {
+        const PointLight& pointLight = frame.pointLights[lights[i]];
+
+        gl::State().uniform(instance.drawablePointLights[i].position,
+                            pointLight.position);
+        gl::State().uniform(instance.drawablePointLights[i].color,
+                            pointLight.color);
+        gl::State().uniform(instance.drawablePointLights[i].linearAttenuation,
+                            0.7f);
+        gl::State().uniform(
+          instance.drawablePointLights[i].quadraticAttenuation, 0.2f);
+      }
 
-      gl::BindBuffer bindBuffer(GL_ARRAY_BUFFER, drawCommand.buffer);
+      // Once for all the SubShapes
+      const glm::mat4 ViewProjectionModel =
+        frame.ViewProjection * drawCommand.transformation;
+      const glm::mat3 normalMatrix = NormalMatrix(drawCommand.transformation);
 
-      glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, normal));
-      glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, color));
-      glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, uv));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      glEnableVertexAttribArray(3);
+      for (const auto& sub : shape.getSubShapes()) {
+        const SubShapeRange& range = shape.getRange(sub);
+        BindSubShape(shape, range);
 
-#if 0
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-#else
-      if (ControllerService::GetPlayerController().option1)
-        glEnable(GL_BLEND);
-      else
-        glDisable(GL_BLEND);
-#endif
-      for (const auto& sub : *drawCommand.sub) {
         // Setting Materials
         // -------------------------------------------------------
-        glUniform3fv(instance.drawableMaterial.ambiantColor, 1,
-                     glm::value_ptr(sub.material.ambiantColor));
-        glUniform1f(instance.drawableMaterial.shininess,
-                    sub.material.shininess);
-        glUniform3fv(instance.drawableMaterial.emissiveColor, 1,
-                     glm::value_ptr(sub.material.emissiveColor));
-        glUniform3fv(instance.drawableMaterial.diffuseColor, 1,
-                     glm::value_ptr(sub.material.diffuseColor));
-        glUniform3fv(instance.drawableMaterial.specularColor, 1,
-                     glm::value_ptr(sub.material.specularColor));
+        SetMaterialBlending(sub.material);
+        gl::State().uniform(instance.drawableMaterial.ambiantColor,
+                            sub.material.ambiantColor);
+        gl::State().uniform(instance.drawableMaterial.shininess,
+                            sub.material.shininess);
+        gl::State().uniform(instance.drawableMaterial.emissiveColor,
+                            sub.material.emissiveColor);
+        gl::State().uniform(instance.drawableMaterial.diffuseColor,
+                            sub.material.diffuseColor);
+        gl::State().uniform(instance.drawableMaterial.specularColor,
+                            sub.material.specularColor);
 
         // Setting Textures
         // --------------------------------------------------------
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sub.material.diffuseMap);
-        glUniform1i(instance.drawableMaterial.diffuseMap, 0);
+        gl::State().activeTexture(GL_TEXTURE0);
+        gl::State().bindTexture(GL_TEXTURE_2D, sub.material.diffuseMap);
+        gl::State().uniform(instance.drawableMaterial.diffuseMap, 0);
 
-        auto ViewProjectionModel =
-          frame.ViewProjection * drawCommand.transformation;
         glUniformMatrix4fv(instance.drawableMVPMatrix, 1, GL_FALSE,
                            glm::value_ptr(ViewProjectionModel));
 
@@ -198,114 +332,110 @@ namespace Soleil {
     auto NormalMatrix = glm::mat3(ModelView);
 #endif
 
-        auto NormalMatrix =
-          glm::transpose(glm::inverse(glm::mat3(drawCommand.transformation)));
-
         glUniformMatrix3fv(instance.drawableNormalMatrix, 1, GL_FALSE,
-                           glm::value_ptr(NormalMatrix));
+                           glm::value_ptr(normalMatrix));
         throwOnGlError();
 
-        const std::vector<GLushort>& indices = sub.indices;
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
-                       indices.data());
+        DrawSubShape(range);
       }
     }
+    UnbindShapeBuffers();
   }
 
-  void RenderFlatShape(const RenderInstances& instances, const Frame& frame)
+  static void SetFlatShapeFrame(const FlatShape& flat, const Frame& frame)
   {
+    gl::State().uniform(flat.AmbiantLight, gval::ambiantLight);
+    gl::State().uniform(flat.EyeDirection, frame.cameraPosition);
     throwOnGlError();
-    constexpr GLsizei         stride    = sizeof(Vertex);
-    const OpenGLDataInstance& instance  = OpenGLDataInstance::Instance();
-    const Program&            rendering = instance.flat.program;
-    glUseProgram(rendering.program);
-
-    // Setting Lights
-    // ----------------------------------------------------------
-    glUniform3fv(instance.flat.AmbiantLight, 1,
-                 glm::value_ptr(gval::ambiantLight));
-
-    glUniform3fv(instance.flat.EyeDirection, 1,
-                 glm::value_ptr(frame.cameraPosition));
-    glUniform1i(instance.flat.NumberOfLights, frame.pointLights.size());
-    throwOnGlError();
+  }
 
-    int i = 0;
-    assert(frame.pointLights.size() < DefinedMaxLights &&
-           "Max number of light exceeded");
-    for (const auto& pointLight : frame.pointLights) {
-      // TODO: Protect to avoid array verflow
-
-      glUniform3fv(instance.flat.PointLights[i].position, 1,
-                   glm::value_ptr(pointLight.position));
-      glUniform3fv(instance.flat.PointLights[i].color, 1,
-                   glm::value_ptr(pointLight.color));
-      glUniform1f(instance.flat.PointLights[i].linearAttenuation,
-                  pointLight.linear);
-      glUniform1f(instance.flat.PointLights[i].quadraticAttenuation,
-                  pointLight.quadratic);
-
-      ++i;
+  /**
+   * Send the lights of the set, to a variant built for its size. The slots
+   * keep their light from a set to the next one, so lights shared by
+   * consecutive draws are not sent again.
+   */
+  static void SetFlatShapeLights(const FlatShape& flat, const Frame& frame,
+                                 const LightSet& lights)
+  {
+    for (int i = 0; i < lights.size(); ++i) {
+      const PointLight& pointLight = frame.pointLights[lights[i]];
+
+      gl::State().uniform(flat.PointLights[i].position, pointLight.position);
+      gl::State().uniform(flat.PointLights[i].color, pointLight.color);
+      gl::State().uniform(flat.PointLights[i].linearAttenuation,
+                          pointLight.linear);
+      gl::State().uniform(flat.PointLights[i].quadraticAttenuation,
+                          pointLight.quadratic);
     }
     throwOnGlError();
+  }
 
-    for (const auto& drawCommand : instances) {
-      gl::BindBuffer bindBuffer(
-        GL_ARRAY_BUFFER, drawCommand.buffer); // TODO: use glBind (check perf)
-      throwOnGlError();
+  /**
+   * Variant of the flat shape program drawing the material with the lights.
+   */
+  static const FlatShape& FlatShapeVariant(const Material& material,
+                                           const bool      instanced,
+                                           const LightSet& lights)
+  {
+    return OpenGLDataInstance::Instance().flatShape(
+      MakeFlatShapeKey(material.features, instanced, lights.size()));
+  }
 
-      glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, normal));
-      glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, color));
-      glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
-                            (const GLvoid*)offsetof(Vertex, uv));
-      throwOnGlError();
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      glEnableVertexAttribArray(3);
-      throwOnGlError();
+  /**
+   * Make the variant current with the uniforms of the frame, unless it already
+   * is the current one.
+   */
+  static void UseFlatShape(const FlatShape*& current, const FlatShape& flat,
+                           const Frame& frame)
+  {
+    if (current == &flat) return;
+
+    current = &flat;
+    gl::State().useProgram(flat.program.program);
+    SetFlatShapeFrame(flat, frame);
+    if (flat.VPMatrix >= 0) {
+      glUniformMatrix4fv(flat.VPMatrix, 1, GL_FALSE,
+                         glm::value_ptr(frame.ViewProjection));
+    }
+  }
 
-      if (ControllerService::GetPlayerController().option1)
-        glEnable(GL_BLEND);
-      else
-        glDisable(GL_BLEND);
-      for (const auto& sub : *drawCommand.sub) {
-        // Setting Materials
-        // -------------------------------------------------------
-        glUniform3fv(instance.flat.Material.ambiantColor, 1,
-                     glm::value_ptr(sub.material.ambiantColor));
-        glUniform1f(instance.flat.Material.shininess, sub.material.shininess);
-        glUniform3fv(instance.flat.Material.emissiveColor, 1,
-                     glm::value_ptr(sub.material.emissiveColor));
-        glUniform3fv(instance.flat.Material.diffuseColor, 1,
-                     glm::value_ptr(sub.material.diffuseColor));
-        glUniform3fv(instance.flat.Material.specularColor, 1,
-                     glm::value_ptr(sub.material.specularColor));
-        throwOnGlError();
+  static void SetFlatShapeMaterial(const FlatShape& flat,
+                                   const Material&  material)
+  {
+    gl::State().uniform(flat.Material.ambiantColor, material.ambiantColor);
+    gl::State().uniform(flat.Material.shininess, material.shininess);
+    gl::State().uniform(flat.Material.emissiveColor, material.emissiveColor);
+    gl::State().uniform(flat.Material.diffuseColor, material.diffuseColor);
+    gl::State().uniform(flat.Material.specularColor, material.specularColor);
+    gl::State().uniform(flat.Material.opacity, material.opacity);
+    SetMaterialBlending(material);
+    throwOnGlError();
 
-        // Setting Textures
-        // --------------------------------------------------------
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sub.material.diffuseMap);
-        glUniform1i(instance.flat.Material.diffuseMap, 0);
-        throwOnGlError();
+    gl::State().activeTexture(GL_TEXTURE0);
+    gl::State().bindTexture(GL_TEXTURE_2D, material.diffuseMap);
+    gl::State().uniform(flat.Material.diffuseMap, 0);
+    throwOnGlError();
+  }
 
-        auto ViewProjectionModel =
-          frame.ViewProjection * drawCommand.transformation;
-        glUniformMatrix4fv(instance.flat.MVPMatrix, 1, GL_FALSE,
-                           glm::value_ptr(ViewProjectionModel));
+  static void SetFlatShapeMatrices(const FlatShape& flat, const glm::mat4& mvp,
+                                   const glm::mat4& model,
+                                   const glm::mat3& normalMatrix)
+  {
+    glUniformMatrix4fv(flat.MVPMatrix, 1, GL_FALSE, glm::value_ptr(mvp));
+    glUniformMatrix4fv(flat.MVMatrix, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix3fv(flat.NormalMatrix, 1, GL_FALSE,
+                       glm::value_ptr(normalMatrix));
+  }
 
+  static void SetFlatShapeTransformation(const FlatShape& flat,
+                                         const glm::mat4& transformation,
+                                         const Frame&     frame)
+  {
 /* The book has a mistake, it says using a MVMatrix while only using the Model
  * Matrix*/
 #if 0
-    auto ModelView = frame.View * drawCommand.transformation;
+    auto ModelView = frame.View * transformation;
 #endif
-        glUniformMatrix4fv(
-          instance.flat.MVMatrix, 1, GL_FALSE,
-          glm::value_ptr(drawCommand.transformation)); // ModelView
 
 /* TODO: If only rotation and isometric (nonshape changing) scaling was
  * performed, the Mat3 is should be fine: */
@@ -313,132 +443,498 @@ namespace Soleil {
     auto NormalMatrix = glm::mat3(ModelView);
 #endif
 
-        auto NormalMatrix =
-          glm::transpose(glm::inverse(glm::mat3(drawCommand.transformation)));
-        // TODO: Allow Draw command to have its transpose to save this
-        // computaiton
+    SetFlatShapeMatrices(flat, frame.ViewProjection * transformation,
+                         transformation, NormalMatrix(transformation));
+  }
+
+  /**
+   * Point the model matrix attributes to the instance buffer, from the given
+   * instance. The instance buffer must be bound.
+   */
+  static void SetFlatShapeInstanceAttributes(const std::size_t first)
+  {
+    const gl::Extensions& extensions = gl::GetExtensions();
+
+    for (GLuint column = 0; column < 4; ++column) {
+      const std::size_t offset =
+        first * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+
+      glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE,
+                            sizeof(glm::mat4), (const GLvoid*)offset);
+      glEnableVertexAttribArray(4 + column);
+      extensions.vertexAttribDivisor(4 + column, 1);
+    }
+    throwOnGlError();
+  }
+
+  static void ResetFlatShapeInstanceAttributes(void)
+  {
+    const gl::Extensions& extensions = gl::GetExtensions();
+
+    for (GLuint column = 0; column < 4; ++column) {
+      extensions.vertexAttribDivisor(4 + column, 0);
+      glDisableVertexAttribArray(4 + column);
+    }
+  }
+
+  void RenderFlatShape(const RenderInstances& instances, const Frame& frame)
+  {
+    throwOnGlError();
+    const FlatShape* current = nullptr;
 
-        glUniformMatrix3fv(instance.flat.NormalMatrix, 1, GL_FALSE,
-                           glm::value_ptr(NormalMatrix));
-        const std::vector<GLushort>& indices = sub.indices;
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
-                       indices.data());
+    for (const auto& drawCommand : instances) {
+      const Shape&   shape = *drawCommand.shape;
+      const LightSet lights =
+        SelectLights(shape, drawCommand.transformation, frame);
+
+      // Once for all the SubShapes
+      const glm::mat4 mvp = frame.ViewProjection * drawCommand.transformation;
+      const glm::mat3 normalMatrix = NormalMatrix(drawCommand.transformation);
+      for (const auto& sub : shape.getSubShapes()) {
+        const SubShapeRange& range = shape.getRange(sub);
+        const FlatShape& flat = FlatShapeVariant(sub.material, false, lights);
+
+        BindSubShape(shape, range);
+        UseFlatShape(current, flat, frame);
+        SetFlatShapeLights(flat, frame, lights);
+        SetFlatShapeMaterial(flat, sub.material);
+        SetFlatShapeMatrices(flat, mvp, drawCommand.transformation,
+                             normalMatrix);
+
+        DrawSubShape(range);
         throwOnGlError();
       }
     }
+    UnbindShapeBuffers();
   }
 
   void RenderFlatShape(const glm::mat4& transformation, const Shape& shape,
                        const Frame& frame)
   {
-    // TODO: Merge the code with method above
     throwOnGlError();
-    constexpr GLsizei         stride    = sizeof(Vertex);
-    const OpenGLDataInstance& instance  = OpenGLDataInstance::Instance();
-    const Program&            rendering = instance.flat.program;
-    glUseProgram(rendering.program);
+    const FlatShape* current = nullptr;
+    const LightSet   lights  = SelectLights(shape, transformation, frame);
 
-    // Setting Lights
-    // ----------------------------------------------------------
-    glUniform3fv(instance.flat.AmbiantLight, 1,
-                 glm::value_ptr(gval::ambiantLight));
+    const glm::mat4 mvp          = frame.ViewProjection * transformation;
+    const glm::mat3 normalMatrix = NormalMatrix(transformation);
+    for (const auto& sub : shape.getSubShapes()) {
+      const SubShapeRange& range = shape.getRange(sub);
+      const FlatShape&     flat = FlatShapeVariant(sub.material, false, lights);
 
-    glUniform3fv(instance.flat.EyeDirection, 1,
-                 glm::value_ptr(frame.cameraPosition));
-    glUniform1i(instance.flat.NumberOfLights, frame.pointLights.size());
-    throwOnGlError();
+      BindSubShape(shape, range);
+      UseFlatShape(current, flat, frame);
+      SetFlatShapeLights(flat, frame, lights);
+      SetFlatShapeMaterial(flat, sub.material);
+      SetFlatShapeMatrices(flat, mvp, transformation, normalMatrix);
 
-    int i = 0;
-    assert(frame.pointLights.size() < DefinedMaxLights &&
-           "Max number of light exceeded");
-    for (const auto& pointLight : frame.pointLights) {
-      // TODO: Protect to avoid array verflow
-
-      glUniform3fv(instance.flat.PointLights[i].position, 1,
-                   glm::value_ptr(pointLight.position));
-      glUniform3fv(instance.flat.PointLights[i].color, 1,
-                   glm::value_ptr(pointLight.color));
-      glUniform1f(instance.flat.PointLights[i].linearAttenuation,
-                  pointLight.linear);
-      glUniform1f(instance.flat.PointLights[i].quadraticAttenuation,
-                  pointLight.quadratic);
-
-      ++i;
+      DrawSubShape(range);
+      throwOnGlError();
     }
-    throwOnGlError();
+    UnbindShapeBuffers();
+  }
 
-    gl::BindBuffer bindBuffer(
-      GL_ARRAY_BUFFER, shape.getBuffer()); // TODO: use glBind (check perf)
-    throwOnGlError();
+  void RenderFlatShapeInstanced(const Shape&     shape,
+                                const glm::mat4* transformations,
+                                const std::size_t count, const Frame& frame)
+  {
+    if (count == 0) return;
 
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
-                          (const GLvoid*)offsetof(Vertex, normal));
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
-                          (const GLvoid*)offsetof(Vertex, color));
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
-                          (const GLvoid*)offsetof(Vertex, uv));
-    throwOnGlError();
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(3);
     throwOnGlError();
+    const OpenGLDataInstance& instance   = OpenGLDataInstance::Instance();
+    const gl::Extensions&     extensions = gl::GetExtensions();
+    const FlatShape*          current    = nullptr;
+
+    if (extensions.instancedArrays == false) {
+      // Same loop as RenderFlatShape
+      for (const auto& sub : shape.getSubShapes()) {
+        const SubShapeRange& range = shape.getRange(sub);
+
+        BindSubShape(shape, range);
+        for (std::size_t i = 0; i < count; ++i) {
+          const LightSet lights =
+            SelectLights(shape, transformations[i], frame);
+          const FlatShape& flat =
+            FlatShapeVariant(sub.material, false, lights);
+
+          UseFlatShape(current, flat, frame);
+          SetFlatShapeLights(flat, frame, lights);
+          SetFlatShapeMaterial(flat, sub.material);
+          SetFlatShapeTransformation(flat, transformations[i], frame);
+          DrawSubShape(range);
+        }
+        throwOnGlError();
+      }
+      UnbindShapeBuffers();
+      return;
+    }
+
+    // A single set of lights for all the instances, around all of them
+    BoundingBox bounds;
+    for (std::size_t i = 0; i < count; ++i)
+      bounds.expandBy(WorldBounds(shape, transformations[i]));
+    const LightSet lights = SelectLights(bounds, frame);
+
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, *instance.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), transformations,
+                 GL_STREAM_DRAW);
 
-    if (ControllerService::GetPlayerController().option1)
-      glEnable(GL_BLEND);
-    else
-      glDisable(GL_BLEND);
     for (const auto& sub : shape.getSubShapes()) {
-      // Setting Materials
-      // -------------------------------------------------------
-      glUniform3fv(instance.flat.Material.ambiantColor, 1,
-                   glm::value_ptr(sub.material.ambiantColor));
-      glUniform1f(instance.flat.Material.shininess, sub.material.shininess);
-      glUniform3fv(instance.flat.Material.emissiveColor, 1,
-                   glm::value_ptr(sub.material.emissiveColor));
-      glUniform3fv(instance.flat.Material.diffuseColor, 1,
-                   glm::value_ptr(sub.material.diffuseColor));
-      glUniform3fv(instance.flat.Material.specularColor, 1,
-                   glm::value_ptr(sub.material.specularColor));
+      const SubShapeRange& range = shape.getRange(sub);
+      const FlatShape&     flat  = FlatShapeVariant(sub.material, true, lights);
+
+      // The instance attributes belong to the vertex array of the SubShape
+      BindSubShape(shape, range);
+      gl::State().bindBuffer(GL_ARRAY_BUFFER, *instance.instanceBuffer);
+      SetFlatShapeInstanceAttributes(0);
+      UseFlatShape(current, flat, frame);
+      SetFlatShapeLights(flat, frame, lights);
+      SetFlatShapeMaterial(flat, sub.material);
+      extensions.drawElementsInstanced(GL_TRIANGLES, range.count,
+                                       GL_UNSIGNED_SHORT,
+                                       (const GLvoid*)range.indexOffset, count);
+      ResetFlatShapeInstanceAttributes();
       throwOnGlError();
+    }
+    UnbindShapeBuffers();
+  }
 
-      // Setting Textures
-      // --------------------------------------------------------
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, sub.material.diffuseMap);
-      glUniform1i(instance.flat.Material.diffuseMap, 0);
-      throwOnGlError();
+  // ------ RenderQueue ------
 
-      auto ViewProjectionModel = frame.ViewProjection * transformation;
-      glUniformMatrix4fv(instance.flat.MVPMatrix, 1, GL_FALSE,
-                         glm::value_ptr(ViewProjectionModel));
+  // Distance to the camera mapped on the depth bits of the key. Farther
+  // elements share the last value, that only weakens front to back ordering.
+  static constexpr float RenderQueueDepthRange = 64.0f;
 
-/* The book has a mistake, it says using a MVMatrix while only using the Model
- * Matrix*/
-#if 0
-    auto ModelView = frame.View * drawCommand.transformation;
-#endif
-      glUniformMatrix4fv(instance.flat.MVMatrix, 1, GL_FALSE,
-                         glm::value_ptr(transformation)); // ModelView
+  std::uint64_t RenderQueue::MakeKey(std::uint32_t program,
+                                     std::uint32_t buffer,
+                                     std::uint32_t texture,
+                                     float         depth) noexcept
+  {
+    constexpr std::uint64_t depthMask = (1u << 24) - 1;
+    const std::uint64_t     quantizedDepth =
+      (std::uint64_t)(glm::clamp(depth / RenderQueueDepthRange, 0.0f, 1.0f) *
+                      depthMask);
+
+    // Past the width of their field, the objects share its last value, that
+    // only weakens the sort
+    return ((std::uint64_t)std::min<std::uint32_t>(program, 0xFF) << 56) |
+           ((std::uint64_t)std::min<std::uint32_t>(buffer, 0xFFFF) << 40) |
+           ((std::uint64_t)std::min<std::uint32_t>(texture, 0xFFFF) << 24) |
+           quantizedDepth;
+  }
 
-/* TODO: If only rotation and isometric (nonshape changing) scaling was
- * performed, the Mat3 is should be fine: */
-#if 0
-    auto NormalMatrix = glm::mat3(ModelView);
-#endif
+  void RenderQueue::clear(void) noexcept
+  {
+    items.clear();
+    blendedItems.clear();
+    models.clear();
+    normalMatrices.clear();
+    stats = Stats();
+  }
 
-      auto NormalMatrix =
-        glm::transpose(glm::inverse(glm::mat3(transformation)));
-      // TODO: Allow Draw command to have its transpose to save this computaiton
+  /**
+   * Whether the model matrix is a rotation and a uniform scale, so the
+   * instanced variant may transform the normals with it.
+   */
+  static bool IsUniformlyScaled(const glm::mat4& model) noexcept
+  {
+    const glm::vec3 x(model[0]);
+    const glm::vec3 y(model[1]);
+    const glm::vec3 z(model[2]);
+    const float     scale   = glm::dot(x, x);
+    const float     epsilon = scale * 1e-4f;
+
+    return std::abs(glm::dot(y, y) - scale) <= epsilon &&
+           std::abs(glm::dot(z, z) - scale) <= epsilon &&
+           std::abs(glm::dot(x, y)) <= epsilon &&
+           std::abs(glm::dot(x, z)) <= epsilon &&
+           std::abs(glm::dot(y, z)) <= epsilon;
+  }
 
-      glUniformMatrix3fv(instance.flat.NormalMatrix, 1, GL_FALSE,
-                         glm::value_ptr(NormalMatrix));
-      const std::vector<GLushort>& indices = sub.indices;
-      glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
-                     indices.data());
+  void RenderQueue::push(const Shape& shape, const glm::mat4& transformation,
+                         const glm::mat3& normalMatrix,
+                         const BoundingBox& bounds, const Frame& frame)
+  {
+    const LightSet lights = SelectLights(bounds, frame);
+    const float    depth =
+      glm::length(glm::vec3(transformation[3]) - frame.cameraPosition);
+
+    const std::uint32_t element      = models.size();
+    const bool          uniformScale = IsUniformlyScaled(transformation);
+    models.push_back(transformation);
+    normalMatrices.push_back(normalMatrix);
+
+    for (const auto& sub : shape.getSubShapes()) {
+      const FlatShape& flat = FlatShapeVariant(sub.material, false, lights);
+
+      if (sub.material.features & MaterialFeature::AlphaBlend) {
+        // Only the distance matters, the farthest ones first
+        const glm::vec3 center = (bounds.getMin() + bounds.getMax()) * 0.5f;
+        const float     distance =
+          glm::length(center - frame.cameraPosition);
+
+        blendedItems.push_back(
+          {MakeKey(0, 0, 0, RenderQueueDepthRange - distance), &shape, &sub,
+           &flat, element, lights, uniformScale});
+        continue;
+      }
+
+      const std::uint32_t texture =
+        sub.material.texture ? sub.material.texture->index() : 0;
+      items.push_back({MakeKey(flat.program.index, shape.getBufferIndex(),
+                               texture, depth),
+                       &shape, &sub, &flat, element, lights, uniformScale});
+    }
+  }
+
+  void RenderQueue::push(const Shape& shape, const glm::mat4& transformation,
+                         const Frame& frame)
+  {
+    push(shape, transformation, NormalMatrix(transformation),
+         WorldBounds(shape, transformation), frame);
+  }
+
+  void RenderQueue::push(const std::vector<DrawElement>& elements,
+                         const std::vector<ShapePtr>&    shapes,
+                         const Frame&                    frame)
+  {
+    for (const auto& e : elements) {
+      const Shape& shape = *shapes[e.shapeIndex];
+
+      push(shape, e.transformation, e.normalMatrix,
+           WorldBounds(shape, e.transformation), frame);
+    }
+    stats.drawn += elements.size();
+  }
+
+  void RenderQueue::push(const std::vector<ShapePtr>& worldShapes,
+                         const Frame&                 frame)
+  {
+    // Shapes already expressed in world space (e.g. the baked statics)
+    static const glm::mat4 identity;
+    static const glm::mat3 normalIdentity;
+
+    for (const auto& shape : worldShapes) {
+      push(*shape, identity, normalIdentity, shape->getBounds(), frame);
+    }
+    stats.drawn += worldShapes.size();
+  }
+
+  void RenderQueue::push(const std::vector<DrawElement>& elements,
+                         const std::vector<ShapePtr>&    shapes,
+                         const BoxArray& bounds, const Frustum& frustum,
+                         const Frame& frame, const Pvs* pvs)
+  {
+    assert(bounds.size() == elements.size() && "Bounds out of sync");
+
+    const std::size_t visible = cull(bounds, frustum, frame, pvs);
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+      if (visibility[i])
+        push(*shapes[elements[i].shapeIndex], elements[i].transformation,
+             elements[i].normalMatrix, bounds.get(i), frame);
+    }
+    stats.drawn += visible;
+    stats.culled += elements.size() - visible;
+  }
+
+  void RenderQueue::push(const std::vector<ShapePtr>& worldShapes,
+                         const BoxArray& bounds, const Frustum& frustum,
+                         const Frame& frame, const Pvs* pvs)
+  {
+    static const glm::mat4 identity;
+    static const glm::mat3 normalIdentity;
+
+    assert(bounds.size() == worldShapes.size() && "Bounds out of sync");
+
+    const std::size_t visible = cull(bounds, frustum, frame, pvs);
+    for (std::size_t i = 0; i < worldShapes.size(); ++i) {
+      if (visibility[i])
+        push(*worldShapes[i], identity, normalIdentity, bounds.get(i), frame);
+    }
+    stats.drawn += visible;
+    stats.culled += worldShapes.size() - visible;
+  }
+
+  std::size_t RenderQueue::cull(const BoxArray& bounds, const Frustum& frustum,
+                                const Frame& frame, const Pvs* pvs)
+  {
+    const std::size_t visible = bounds.cull(frustum, visibility);
+    if (pvs == nullptr || pvs->empty() || visible == 0) return visible;
+
+    pvs->cull(frame.cameraPosition, bounds, visibility);
+    return std::count(visibility.begin(), visibility.end(), 1);
+  }
+
+  void RenderQueue::sort(void)
+  {
+    // Within the same state, items sharing their lights are kept together
+    // before going front to back
+    constexpr int depthBits = 24;
+
+    std::sort(items.begin(), items.end(),
+              [](const RenderItem& a, const RenderItem& b) {
+                if ((a.key >> depthBits) != (b.key >> depthBits))
+                  return a.key < b.key;
+                if (a.lights != b.lights) return a.lights < b.lights;
+                return a.key < b.key;
+              });
+    std::stable_sort(blendedItems.begin(), blendedItems.end(),
+                     [](const RenderItem& a, const RenderItem& b) {
+                       return a.key < b.key;
+                     });
+  }
+
+  // Shortest run of a SubShape to draw with instancing
+  static constexpr std::size_t RenderQueueInstancingMin = 4;
+
+  /**
+   * Call function(first, count) for each run of items sharing the same
+   * SubShape and lights, either all uniformly scaled or none.
+   */
+  template <typename Function>
+  static void ForEachRun(const std::vector<RenderItem>& items,
+                         Function                       function)
+  {
+    for (std::size_t first = 0; first < items.size();) {
+      std::size_t last = first + 1;
+      while (last < items.size() && items[last].sub == items[first].sub &&
+             items[last].lights == items[first].lights &&
+             items[last].uniformScale == items[first].uniformScale)
+        ++last;
+
+      function(first, last - first);
+      first = last;
+    }
+  }
+
+  /**
+   * The instanced variant transforms the normals with the model matrix, the
+   * non-uniformly scaled items are drawn one by one with their normal matrix.
+   */
+  static inline bool IsInstancedRun(const std::vector<RenderItem>& items,
+                                    const std::size_t first,
+                                    const std::size_t count) noexcept
+  {
+    return count >= RenderQueueInstancingMin && items[first].uniformScale;
+  }
+
+  void RenderQueue::flush(const Frame& frame)
+  {
+    if (items.empty() && blendedItems.empty()) return;
+
+    throwOnGlError();
+    const OpenGLDataInstance& instance   = OpenGLDataInstance::Instance();
+    const gl::Extensions&     extensions = gl::GetExtensions();
+    const bool useInstancing             = extensions.instancedArrays;
+
+    // Transform stage: the matrices of all elements in a single pass
+    // ----------------------------------------------------------
+    mvps.resize(models.size());
+    MultiplyMatrices(frame.ViewProjection, models.data(), mvps.data(),
+                     models.size());
+
+    // Runs long enough are drawn first, all at once
+    // ----------------------------------------------------------
+    instances.clear();
+    if (useInstancing) {
+      ForEachRun(items, [this](std::size_t first, std::size_t count) {
+        if (IsInstancedRun(items, first, count) == false) return;
+
+        for (std::size_t i = first; i < first + count; ++i)
+          instances.push_back(models[items[i].element]);
+      });
+    }
+
+    const FlatShape* current = nullptr;
+    if (instances.empty() == false) {
+      gl::State().bindBuffer(GL_ARRAY_BUFFER, *instance.instanceBuffer);
+      glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4),
+                   instances.data(), GL_STREAM_DRAW);
+
+      std::size_t     instanceOffset  = 0;
+      const Material* currentMaterial = nullptr;
+      ForEachRun(items, [&](std::size_t first, std::size_t count) {
+        if (IsInstancedRun(items, first, count) == false) return;
+
+        // The vertices are set for each run as the instance attributes then
+        // belong to the vertex array of its SubShape.
+        const RenderItem&    item  = items[first];
+        const SubShapeRange& range = item.shape->getRange(*item.sub);
+        const FlatShape&     flat =
+          FlatShapeVariant(item.sub->material, true, item.lights);
+        BindSubShape(*item.shape, range);
+        if (&flat != current) {
+          // The uniforms of the material are set per program
+          UseFlatShape(current, flat, frame);
+          currentMaterial = nullptr;
+        }
+        if (&item.sub->material != currentMaterial) {
+          currentMaterial = &item.sub->material;
+          SetFlatShapeMaterial(flat, *currentMaterial);
+        }
+        SetFlatShapeLights(flat, frame, item.lights);
+
+        gl::State().bindBuffer(GL_ARRAY_BUFFER, *instance.instanceBuffer);
+        SetFlatShapeInstanceAttributes(instanceOffset);
+
+        extensions.drawElementsInstanced(GL_TRIANGLES, range.count,
+                                         GL_UNSIGNED_SHORT,
+                                         (const GLvoid*)range.indexOffset,
+                                         count);
+        ResetFlatShapeInstanceAttributes();
+        throwOnGlError();
+        instanceOffset += count;
+      });
+    }
+
+    // Then the remaining items one by one
+    // ----------------------------------------------------------
+    const Material* currentMaterial = nullptr;
+    ForEachRun(items, [&](std::size_t first, std::size_t count) {
+      if (useInstancing && IsInstancedRun(items, first, count)) return;
+
+      // The items of a run share their SubShape, hence its buffers, and
+      // their lights
+      const RenderItem&    run   = items[first];
+      const SubShapeRange& range = run.shape->getRange(*run.sub);
+      const FlatShape&     flat  = *run.flat;
+      BindSubShape(*run.shape, range);
+      if (&flat != current) {
+        UseFlatShape(current, flat, frame);
+        currentMaterial = nullptr;
+      }
+      if (&run.sub->material != currentMaterial) {
+        currentMaterial = &run.sub->material;
+        SetFlatShapeMaterial(flat, *currentMaterial);
+      }
+      SetFlatShapeLights(flat, frame, run.lights);
+
+      for (std::size_t i = first; i < first + count; ++i) {
+        const std::uint32_t element = items[i].element;
+        SetFlatShapeMatrices(flat, mvps[element], models[element],
+                             normalMatrices[element]);
+
+        DrawSubShape(range);
+        throwOnGlError();
+      }
+    });
+
+    // Last the blended items, back to front
+    // ----------------------------------------------------------
+    for (const RenderItem& item : blendedItems) {
+      const SubShapeRange& range = item.shape->getRange(*item.sub);
+      const FlatShape&     flat  = *item.flat;
+      const std::uint32_t  e     = item.element;
+
+      BindSubShape(*item.shape, range);
+      UseFlatShape(current, flat, frame);
+      SetFlatShapeMaterial(flat, item.sub->material);
+      SetFlatShapeLights(flat, frame, item.lights);
+      SetFlatShapeMatrices(flat, mvps[e], models[e], normalMatrices[e]);
+
+      DrawSubShape(range);
       throwOnGlError();
     }
+    UnbindShapeBuffers();
   }
 
   void Fade(const float ratio)
@@ -493,25 +989,24 @@ namespace Soleil {
   void DrawBoundingBox(const BoundingBox& box, const Frame& frame,
                        const glm::vec4& color)
   {
-    constexpr GLsizei       stride    = sizeof(GLfloat) * 3;
     const BoundingBoxShape& shape     = OpenGLDataInstance::Instance().box;
     const Program&          rendering = shape.program;
 
-    glUseProgram(rendering.program);
-    glBindBuffer(GL_ARRAY_BUFFER, *shape.buffer);
-    glUniform3fv(shape.min, 1, glm::value_ptr(box.getMin()));
-    glUniform3fv(shape.max, 1, glm::value_ptr(box.getMax()));
-    glUniform4fv(shape.color, 1, glm::value_ptr(color)); // TODO: Add color;
+    gl::State().useProgram(rendering.program);
+    if (*shape.vertexArray)
+      gl::GlBindVertexArray(*shape.vertexArray);
+    else {
+      gl::State().bindBuffer(GL_ARRAY_BUFFER, *shape.buffer);
+      gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *shape.indexBuffer);
+      SetBoxVertexAttributes();
+    }
+    gl::State().uniform(shape.min, box.getMin());
+    gl::State().uniform(shape.max, box.getMax());
+    gl::State().uniform(shape.color, color); // TODO: Add color;
     glUniformMatrix4fv(shape.VPMatrix, 1, GL_FALSE,
                        glm::value_ptr(frame.ViewProjection));
     throwOnGlError();
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
-    throwOnGlError();
-
-    glEnableVertexAttribArray(0);
-    throwOnGlError();
-
     const std::vector<GLushort>& indices = shape.indices;
     assert(indices.size() == 36);
 #if 0
@@ -519,7 +1014,9 @@ namespace Soleil {
 #endif
 
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
-                   indices.data());
+                   (const GLvoid*)0);
+    gl::GlBindVertexArray(0);
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     throwOnGlError();
   }
 
@@ -22,13 +22,20 @@
 #ifndef SOLEIL__DRAW_HPP_
 #define SOLEIL__DRAW_HPP_
 
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "BoundingBox.hpp"
+#include "Culling.hpp"
 #include "OpenGLInclude.hpp"
+#include "Pvs.hpp"
 #include "Shape.hpp"
+#include "Transform.hpp"
 #include "types.hpp"
 
+#include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 
 namespace Soleil {
@@ -38,15 +45,25 @@ namespace Soleil {
   {
     size_t      shapeIndex;     // Index in the shape vector
     glm::mat4   transformation; // Current transfromation
+    glm::mat3   normalMatrix;   // Of the transformation, see updateNormalMatrix
     std::size_t id;             // An id that should be unique for picking
 
     DrawElement(size_t shapeIndex, const glm::mat4& transformation)
       : shapeIndex(shapeIndex)
       , transformation(transformation)
+      , normalMatrix(NormalMatrix(transformation))
     {
       id = Hash(*this);
     }
 
+    /**
+     * To be called once the transformation of a moving element is changed
+     */
+    void updateNormalMatrix(void) noexcept
+    {
+      normalMatrix = NormalMatrix(transformation);
+    }
+
     DrawElement()
       : id(0)
     {
@@ -69,44 +86,43 @@ namespace Soleil {
 
   struct DrawCommand
   {
-    GLuint                       buffer;
-    glm::mat4                    transformation;
-    std::vector<SubShape> const* sub;
-
-    DrawCommand(GLuint buffer, const glm::mat4& transformation,
-                const std::vector<SubShape>& sub)
-      : buffer(buffer)
-      , transformation(transformation)
-      , sub(&sub)
-    {
-    }
-
-    DrawCommand(GLuint buffer, const glm::mat4& transformation,
-                const std::vector<SubShape>* sub)
-      : buffer(buffer)
-      , transformation(transformation)
-      , sub(sub)
-    {
-    }
+    const Shape* shape; // Holds the vertex and index buffers
+    glm::mat4    transformation;
 
     DrawCommand(const Shape& shape, const glm::mat4& transformation)
-      : buffer(shape.getBuffer())
+      : shape(&shape)
       , transformation(transformation)
-      , sub(&shape.getSubShapes())
     {
     }
 
     bool operator==(const DrawCommand& other) const noexcept
     {
-      return buffer == other.buffer && transformation == other.transformation &&
-             sub == other.sub;
+      return shape == other.shape && transformation == other.transformation;
     }
   };
 
+  struct CharVertex
+  {
+    glm::vec3 position;
+    glm::vec2 uv;
+  };
+
+  /**
+   * Vertices of the quads of a laid out text, four per glyph, shared through
+   * the Text::LayoutCache
+   */
+  typedef std::shared_ptr<const std::vector<CharVertex>> TextQuads;
+
   struct TextCommand
   {
-    gl::Buffer            buffer;
-    std::vector<GLushort> elements;
+    TextQuads quads;     // Laid out by Text::FillBuffer
+    float     em = 1.0f; // Size given to Text::FillBuffer
+
+    // Where DrawText streamed the quads in the TextStream, valid as long as
+    // its generation is the same. The texts larger than the stream are
+    // streamed by chunks at each draw.
+    GLintptr streamOffset     = 0;
+    unsigned streamGeneration = 0;
   };
 
   class PopUp
@@ -134,13 +150,122 @@ namespace Soleil {
     Timer startTime;
   };
 
-  struct CharVertex
+  /**
+   * Point the attributes of the text program to the CharVertex of the bound
+   * GL_ARRAY_BUFFER, from the given byte offset.
+   */
+  void SetCharVertexAttributes(const GLintptr offset);
+
+  typedef std::vector<DrawCommand> RenderInstances;
+
+  struct FlatShape;
+
+  /**
+   * One SubShape of one element waiting in a RenderQueue.
+   */
+  struct RenderItem
   {
-    glm::vec3 position;
-    glm::vec2 uv;
+    std::uint64_t    key; // State sort key, see RenderQueue::MakeKey
+    const Shape*     shape;
+    const SubShape*  sub;
+    const FlatShape* flat;    // Program variant of the material and lights
+    std::uint32_t    element; // Index of the matrices of the element
+    LightSet         lights;  // Of the element, in the flushed Frame
+
+    // The model matrix may transform the normals, only such items are drawn
+    // with instancing
+    bool uniformScale;
   };
 
-  typedef std::vector<DrawCommand> RenderInstances;
+  /**
+   * Collect the elements of a frame and submit them sorted by GL state.
+   *
+   * Each item is drawn with the program variant of its material and lights,
+   * set once per group of items sharing it. Vertex buffers, materials and
+   * lights are set once per run of items sharing them. The matrices of all
+   * the elements are computed together before the submission.
+   *
+   * Each element is lit by the few lights reaching its bounds the most, the
+   * frame given to push and flush must hold the same lights.
+   *
+   * When the context supports instancing, long runs of the same SubShape
+   * and lights, not scaled non-uniformly, are drawn in a single call.
+   *
+   * The opaque items are drawn first without blending. The items whose
+   * material blends (MaterialFeature::AlphaBlend) follow, one by one and
+   * back to front.
+   */
+  class RenderQueue
+  {
+  public:
+    void clear(void) noexcept;
+
+    /**
+     * Queue the SubShapes of the elements. The normal matrices of the
+     * DrawElements are taken as is, they must be up to date.
+     */
+    void push(const Shape& shape, const glm::mat4& transformation,
+              const Frame& frame);
+    void push(const std::vector<DrawElement>& elements,
+              const std::vector<ShapePtr>& shapes, const Frame& frame);
+    void push(const std::vector<ShapePtr>& worldShapes, const Frame& frame);
+
+    /**
+     * Same as above, skipping the elements whose bounds are outside of the
+     * frustum, or not in the cells visible from the camera if a pvs is given.
+     * bounds must hold the world space box of each element, in the same order.
+     */
+    void push(const std::vector<DrawElement>& elements,
+              const std::vector<ShapePtr>& shapes, const BoxArray& bounds,
+              const Frustum& frustum, const Frame& frame,
+              const Pvs* pvs = nullptr);
+    void push(const std::vector<ShapePtr>& worldShapes, const BoxArray& bounds,
+              const Frustum& frustum, const Frame& frame,
+              const Pvs* pvs = nullptr);
+    void sort(void);
+    void flush(const Frame& frame);
+
+    std::size_t size(void) const noexcept
+    {
+      return items.size() + blendedItems.size();
+    }
+
+    /**
+     * Number of elements (not SubShapes) pushed since the last clear
+     */
+    struct Stats
+    {
+      std::size_t drawn  = 0;
+      std::size_t culled = 0;
+    };
+    const Stats& getStats(void) const noexcept { return stats; }
+
+  public:
+    /**
+     * Build a key sorting by program, then vertex buffer, then texture and
+     * finally front to back. The objects are given by their dense index,
+     * see gl::AcquireObjectIndex.
+     */
+    static std::uint64_t MakeKey(std::uint32_t program, std::uint32_t buffer,
+                                 std::uint32_t texture, float depth) noexcept;
+
+  private:
+    void push(const Shape& shape, const glm::mat4& transformation,
+              const glm::mat3& normalMatrix, const BoundingBox& bounds,
+              const Frame& frame);
+    std::size_t cull(const BoxArray& bounds, const Frustum& frustum,
+                     const Frame& frame, const Pvs* pvs);
+
+  private:
+    std::vector<RenderItem>   items;
+    std::vector<RenderItem>   blendedItems;   // Keyed by distance, see push
+    std::vector<glm::mat4>    models;         // One per element
+    std::vector<glm::mat3>    normalMatrices; // One per element
+    std::vector<glm::mat4>    mvps;           // One per element, set by flush
+    std::vector<glm::mat4>    instances;      // Models of the instanced runs
+    std::vector<std::uint8_t> visibility;     // Scratch for the culled push
+    Stats                     stats;
+  };
 
   void DrawImage(GLuint texture, const glm::mat4& transformation,
                  const glm::vec4& color = glm::vec4(1.0f));
@@ -148,7 +273,14 @@ namespace Soleil {
   void RenderFlatShape(const RenderInstances& instances, const Frame& frame);
   void RenderFlatShape(const glm::mat4& transformation, const Shape& shape,
                        const Frame& frame);
-  void DrawText(const TextCommand& textCommand, const glm::mat4& transformation,
+  /**
+   * Draw the Shape once per transformation, in a single call per SubShape if
+   * instancing is available. The shapes must not be non-uniformly scaled.
+   */
+  void RenderFlatShapeInstanced(const Shape&      shape,
+                                const glm::mat4*  transformations,
+                                const std::size_t count, const Frame& frame);
+  void DrawText(TextCommand& textCommand, const glm::mat4& transformation,
                 const glm::vec4& color);
   void Fade(const float ratio);
   void DrawBoundingBox(const BoundingBox& box, const Frame& frame,
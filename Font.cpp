@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Font.hpp"
+
+#include "stringutils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_LARGE_RECTS
+#include "stb_rect_pack.h"
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+namespace Soleil {
+
+  const std::wstring GameCharMap =
+    L"ABCDEFGHIJKLMNOPQRSTUVWXYZÀ0123456789abcdefghi"
+    L"jklmnopqrstuvwxyz +-!.():=\",'/";
+
+  static const char          FontMagic[4] = {'F', 'N', 'T', 'A'};
+  static const std::uint32_t FontVersion  = 2;
+
+  // Fields of the file after the magic, in this order
+  struct FontHeader
+  {
+    std::uint32_t version;
+    std::uint32_t fontSize;
+    std::uint64_t charMapHash;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t glyphs;
+    float         distanceRange;
+    float         verticalAdvance;
+  };
+
+  // The distance fields are computed on outlines rasterized this many times
+  // larger, then averaged down
+  static const int DistanceSupersampling = 4;
+
+  // Squared distance standing for no zero in reach
+  static const float NoDistance = 1e20f;
+
+  /**
+   * Squared distance of each sample to the nearest zero of f (Felzenszwalb
+   * and Huttenlocher, linear in n).
+   */
+  static void SquaredDistance1D(const float* f, float* d, const int n,
+                                const int stride, std::vector<int>& v,
+                                std::vector<float>& z)
+  {
+    const auto intersection = [f, stride](const int p, const int q) {
+      return ((f[q * stride] + q * q) - (f[p * stride] + p * p)) /
+             (2.0f * (q - p));
+    };
+    int k = 0;
+
+    v[0] = 0;
+    z[0] = -NoDistance;
+    z[1] = NoDistance;
+    for (int q = 1; q < n; ++q) {
+      float s = intersection(v[k], q);
+      while (s <= z[k]) {
+        --k;
+        s = intersection(v[k], q);
+      }
+      ++k;
+      v[k]     = q;
+      z[k]     = s;
+      z[k + 1] = NoDistance;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+      while (z[k + 1] < q) ++k;
+      d[q] = (q - v[k]) * (q - v[k]) + f[v[k] * stride];
+    }
+  }
+
+  /**
+   * Distance of each pixel of the image to the nearest pixel whose coverage
+   * is (inside) or is not (outside) at least half.
+   */
+  static std::vector<float> DistanceTo(const std::vector<std::uint8_t>& image,
+                                       const int width, const int height,
+                                       const bool inside)
+  {
+    std::vector<float> grid(width * height);
+    std::vector<float> line(std::max(width, height));
+    std::vector<int>   v(line.size());
+    std::vector<float> z(line.size() + 1);
+
+    for (std::size_t i = 0; i < grid.size(); ++i)
+      grid[i] = ((image[i] >= 128) == inside) ? 0.0f : NoDistance;
+
+    for (int x = 0; x < width; ++x) {
+      SquaredDistance1D(&grid[x], line.data(), height, width, v, z);
+      for (int y = 0; y < height; ++y) grid[y * width + x] = line[y];
+    }
+    for (int y = 0; y < height; ++y) {
+      SquaredDistance1D(&grid[y * width], line.data(), width, 1, v, z);
+      for (int x = 0; x < width; ++x)
+        grid[y * width + x] = std::sqrt(line[x]);
+    }
+    return grid;
+  }
+
+  /**
+   * Rasterized glyph, before packing
+   */
+  struct GlyphImage
+  {
+    int                       width;
+    int                       height;
+    std::vector<std::uint8_t> pixels;
+  };
+
+  static GlyphImage RasterizeGlyph(const stbtt_fontinfo& font,
+                                   const wchar_t c, const float scale,
+                                   const float distanceRange,
+                                   BakedFont::Glyph& glyph)
+  {
+    const int sampling = (distanceRange > 0.0f) ? DistanceSupersampling : 1;
+    const int padding  = (int)std::ceil(distanceRange) * sampling;
+    const float sampleScale = scale * sampling;
+
+    int x0, y0, x1, y1;
+    stbtt_GetCodepointBitmapBox(&font, c, sampleScale, sampleScale, &x0, &y0,
+                                &x1, &y1);
+
+    GlyphImage image = {0, 0, {}};
+    if (x1 <= x0 || y1 <= y0) return image;
+
+    // Padded to the distance range, to a multiple of the sampling
+    image.width  = (x1 - x0 + 2 * padding + sampling - 1) / sampling;
+    image.height = (y1 - y0 + 2 * padding + sampling - 1) / sampling;
+
+    // Box of the image from the pen position, y up
+    glyph.minX = (float)(x0 - padding) / sampling;
+    glyph.maxX = glyph.minX + image.width;
+    glyph.maxY = (float)-(y0 - padding) / sampling;
+    glyph.minY = glyph.maxY - image.height;
+
+    const int                 sampleWidth  = image.width * sampling;
+    const int                 sampleHeight = image.height * sampling;
+    std::vector<std::uint8_t> coverage(sampleWidth * sampleHeight, 0);
+    stbtt_MakeCodepointBitmap(
+      &font, &coverage[padding * sampleWidth + padding], x1 - x0, y1 - y0,
+      sampleWidth, sampleScale, sampleScale, c);
+
+    if (distanceRange <= 0.0f) {
+      image.pixels = std::move(coverage);
+      return image;
+    }
+
+    const std::vector<float> toInside =
+      DistanceTo(coverage, sampleWidth, sampleHeight, true);
+    const std::vector<float> toOutside =
+      DistanceTo(coverage, sampleWidth, sampleHeight, false);
+
+    image.pixels.resize(image.width * image.height);
+    for (int y = 0; y < image.height; ++y) {
+      for (int x = 0; x < image.width; ++x) {
+        // Signed distance in pixels of the font size, positive inside. The
+        // half sample puts the outline between the samples.
+        float distance = 0.0f;
+        for (int j = 0; j < sampling; ++j) {
+          for (int i = 0; i < sampling; ++i) {
+            const int sample =
+              (y * sampling + j) * sampleWidth + x * sampling + i;
+            distance += (toInside[sample] > 0.0f) ? -(toInside[sample] - 0.5f)
+                                                  : toOutside[sample] - 0.5f;
+          }
+        }
+        distance /= sampling * sampling * sampling;
+
+        const float value = 0.5f + 0.5f * distance / distanceRange;
+        image.pixels[y * image.width + x] = (std::uint8_t)std::round(
+          255.0f * std::min(std::max(value, 0.0f), 1.0f));
+      }
+    }
+    return image;
+  }
+
+  BakedFont BakedFont::Bake(const std::wstring&              charMap,
+                            const std::vector<std::uint8_t>& ttf,
+                            const int fontSize, const float distanceRange,
+                            const int maxWidth, const int maxHeight)
+  {
+    stbtt_fontinfo font;
+    if (stbtt_InitFont(&font, ttf.data(),
+                       stbtt_GetFontOffsetForIndex(ttf.data(), 0)) == 0)
+      throw std::runtime_error("Failed to init the font");
+
+    const float scale = stbtt_ScaleForPixelHeight(&font, fontSize);
+    int         ascent;
+    int         descent;
+    int         lineGap;
+    stbtt_GetFontVMetrics(&font, &ascent, &descent, &lineGap);
+
+    BakedFont baked;
+    baked.charMapHash     = Hash(charMap, fontSize, distanceRange);
+    baked.fontSize        = fontSize;
+    baked.distanceRange   = distanceRange;
+    baked.verticalAdvance = (ascent - descent + lineGap) * scale;
+
+    std::vector<GlyphImage> images;
+    std::vector<stbrp_rect> rects;
+    for (const wchar_t c : charMap) {
+      int advance;
+      int leftSideBearing;
+      stbtt_GetCodepointHMetrics(&font, c, &advance, &leftSideBearing);
+
+      Glyph glyph = {(std::uint32_t)c, 0, 0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f,
+                     advance * scale};
+      images.push_back(
+        RasterizeGlyph(font, c, scale, distanceRange, glyph));
+      glyph.width  = images.back().width;
+      glyph.height = images.back().height;
+
+      rects.push_back({(int)rects.size(), glyph.width, glyph.height, 0, 0, 0});
+      baked.glyphs.push_back(glyph);
+    }
+
+    // Smallest image holding the glyphs, growing one side at a time. One node
+    // per column is enough for the packer.
+    int width     = std::min(128, maxWidth);
+    int height    = std::min(128, maxHeight);
+    int allPacked = 0;
+    for (;;) {
+      stbrp_context           context;
+      std::vector<stbrp_node> nodes(width);
+      stbrp_init_target(&context, width, height, nodes.data(), nodes.size());
+      allPacked = stbrp_pack_rects(&context, rects.data(), rects.size());
+
+      if (allPacked || (width >= maxWidth && height >= maxHeight)) break;
+      if (height < width && height < maxHeight)
+        height *= 2;
+      else if (width < maxWidth)
+        width *= 2;
+      else
+        height *= 2;
+    }
+
+    if (allPacked == 0)
+      throw std::runtime_error(toString("The ", charMap.size(),
+                                        " glyphs do not fit in ", maxWidth, "x",
+                                        maxHeight));
+
+    baked.width  = width;
+    baked.height = height;
+    baked.pixels.assign(width * height, 0);
+    for (const stbrp_rect& rect : rects) {
+      Glyph&            glyph = baked.glyphs[rect.id];
+      const GlyphImage& image = images[rect.id];
+
+      glyph.x = rect.x;
+      glyph.y = rect.y;
+      for (int row = 0; row < image.height; ++row) {
+        std::memcpy(&baked.pixels[(rect.y + row) * width + rect.x],
+                    &image.pixels[row * image.width], image.width);
+      }
+    }
+    return baked;
+  }
+
+  std::vector<std::uint8_t> BakedFont::serialize(void) const
+  {
+    // Zeroed first, the padding of the header is written too
+    FontHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.version         = FontVersion;
+    header.fontSize        = fontSize;
+    header.charMapHash     = charMapHash;
+    header.width           = width;
+    header.height          = height;
+    header.glyphs          = glyphs.size();
+    header.distanceRange   = distanceRange;
+    header.verticalAdvance = verticalAdvance;
+
+    std::vector<std::uint8_t> out(FontMagic, FontMagic + sizeof(FontMagic));
+    const auto append = [&out](const void* data, const std::size_t size) {
+      const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+      out.insert(out.end(), bytes, bytes + size);
+    };
+    append(&header, sizeof(header));
+    append(glyphs.data(), sizeof(Glyph) * glyphs.size());
+    append(pixels.data(), pixels.size());
+    return out;
+  }
+
+  bool BakedFont::Deserialize(const std::vector<std::uint8_t>& content,
+                              const std::uint64_t charMapHash, BakedFont& font)
+  {
+    FontHeader  header;
+    std::size_t offset = sizeof(FontMagic) + sizeof(header);
+    if (content.size() < offset ||
+        std::memcmp(content.data(), FontMagic, sizeof(FontMagic)) != 0)
+      return false;
+
+    std::memcpy(&header, content.data() + sizeof(FontMagic), sizeof(header));
+    const std::size_t glyphBytes = sizeof(Glyph) * header.glyphs;
+    const std::size_t pixelBytes = (std::size_t)header.width * header.height;
+    if (header.version != FontVersion || header.charMapHash != charMapHash ||
+        content.size() != offset + glyphBytes + pixelBytes)
+      return false;
+
+    BakedFont read;
+    read.charMapHash     = header.charMapHash;
+    read.fontSize        = header.fontSize;
+    read.width           = header.width;
+    read.height          = header.height;
+    read.distanceRange   = header.distanceRange;
+    read.verticalAdvance = header.verticalAdvance;
+    read.glyphs.resize(header.glyphs);
+    std::memcpy(read.glyphs.data(), content.data() + offset, glyphBytes);
+    offset += glyphBytes;
+    read.pixels.assign(content.begin() + offset, content.end());
+
+    font = std::move(read);
+    return true;
+  }
+
+  std::uint64_t BakedFont::Hash(const std::wstring& charMap,
+                                const int          fontSize,
+                                const float        distanceRange) noexcept
+  {
+    std::uint64_t hash = 14695981039346656037ull;
+    const auto    mix  = [&hash](const std::uint32_t value) {
+      for (int i = 0; i < 4; ++i) {
+        hash ^= (value >> (8 * i)) & 0xFF;
+        hash *= 1099511628211ull;
+      }
+    };
+
+    for (const wchar_t c : charMap) mix(c);
+    mix(fontSize);
+    mix((std::uint32_t)(distanceRange * 256.0f));
+    return hash;
+  }
+
+} // Soleil
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SOLEIL__FONT_HPP_
+#define SOLEIL__FONT_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Soleil {
+
+  /**
+   * Characters of the texts of the game, the ones baked in its font atlas
+   */
+  extern const std::wstring GameCharMap;
+
+  /**
+   * Rasterization of the font atlas of the game: a distance field, sharp at
+   * any text size
+   */
+  static const int   GameFontSize          = 32;
+  static const float GameFontDistanceRange = 4.0f;
+
+  /**
+   * Glyphs of a font rasterized and packed in a single channel image, with
+   * their metrics in pixels of the rasterized size. The metrics do not
+   * depend on the viewport, they are scaled to it at load.
+   *
+   * With a distance range, the image holds the signed distance to the outline
+   * of the glyphs instead of their coverage: 0.5 on the outline, growing
+   * inside, reaching 0 and 1 at distanceRange pixels away. The text stays
+   * sharp at any size from a small image.
+   *
+   * fontBaker writes it next to the font as <font>.atlas, so the game does
+   * not rasterize the font at each launch.
+   */
+  struct BakedFont
+  {
+    // Stored as is in the file
+    struct Glyph
+    {
+      std::uint32_t codePoint;
+      std::uint16_t x; // Position and size in the image
+      std::uint16_t y;
+      std::uint16_t width;
+      std::uint16_t height;
+      float         minX; // Box from the pen position, y up
+      float         minY;
+      float         maxX;
+      float         maxY;
+      float         advance;
+    };
+
+    std::uint64_t             charMapHash; // See Hash
+    int                       fontSize;    // Pixel height of the glyphs
+    int                       width;       // Of the image
+    int                       height;
+    float                     distanceRange;   // 0 for a coverage image
+    float                     verticalAdvance; // Between two lines
+    std::vector<Glyph>        glyphs;
+    std::vector<std::uint8_t> pixels; // width * height alpha values
+
+    /**
+     * Rasterize the characters of the TrueType font, as a distance field if
+     * distanceRange is not 0. The image is the smallest power of two size
+     * holding the glyphs, up to maxWidth x maxHeight. Throw if they do not
+     * fit.
+     */
+    static BakedFont Bake(const std::wstring&              charMap,
+                          const std::vector<std::uint8_t>& ttf,
+                          const int fontSize, const float distanceRange,
+                          const int maxWidth, const int maxHeight);
+
+    std::vector<std::uint8_t> serialize(void) const;
+
+    /**
+     * Read a font written by serialize. Return false if the content is not
+     * valid or was baked for other characters.
+     */
+    static bool Deserialize(const std::vector<std::uint8_t>& content,
+                            const std::uint64_t charMapHash, BakedFont& font);
+
+    /**
+     * Stable hash of the characters and rasterization of a font (64 bits
+     * FNV-1a)
+     */
+    static std::uint64_t Hash(const std::wstring& charMap, const int fontSize,
+                              const float distanceRange) noexcept;
+  };
+
+} // Soleil
+
+#endif /* SOLEIL__FONT_HPP_ */
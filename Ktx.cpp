@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Ktx.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Soleil {
+
+  static const std::uint8_t KtxIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+  static constexpr std::uint32_t KtxEndianness = 0x04030201;
+
+  // Modifiers of the ETC1 intensity tables, by pixel index
+  static const int Etc1Modifiers[8][4] = {
+    {2, 8, -2, -8},       {5, 17, -5, -17},     {9, 29, -9, -29},
+    {13, 42, -13, -42},   {18, 60, -18, -60},   {24, 80, -24, -80},
+    {33, 106, -33, -106}, {47, 183, -47, -183}};
+
+  /**
+   * RGB of the 16 pixels of a block, by x * 4 + y as the ETC1 indices
+   */
+  typedef int BlockPixels[16][3];
+
+  /**
+   * Side by side 2x4 sub blocks, or 4x2 ones on top of each other if flipped
+   */
+  static int SubBlock(const int pixel, const bool flip) noexcept
+  {
+    return ((flip ? pixel % 4 : pixel / 4) >= 2) ? 1 : 0;
+  }
+
+  /**
+   * Pick the table and the pixel indices (2 bits per pixel) of the sub block
+   * closest to its pixels. Return the squared error.
+   */
+  static int FitSubBlock(const BlockPixels& pixels, const int subBlock,
+                         const bool flip, const int base[3], int& table,
+                         std::uint32_t& indices) noexcept
+  {
+    int best = std::numeric_limits<int>::max();
+    for (int t = 0; t < 8; ++t) {
+      int           error        = 0;
+      std::uint32_t tableIndices = 0;
+
+      for (int p = 0; p < 16; ++p) {
+        if (SubBlock(p, flip) != subBlock) continue;
+
+        int pixelError = std::numeric_limits<int>::max();
+        int pixelIndex = 0;
+        for (int i = 0; i < 4; ++i) {
+          int e = 0;
+          for (int c = 0; c < 3; ++c) {
+            const int value =
+              std::min(255, std::max(0, base[c] + Etc1Modifiers[t][i]));
+            e += (value - pixels[p][c]) * (value - pixels[p][c]);
+          }
+          if (e < pixelError) {
+            pixelError = e;
+            pixelIndex = i;
+          }
+        }
+        error += pixelError;
+        tableIndices |= pixelIndex << (2 * p);
+      }
+
+      if (error < best) {
+        best    = error;
+        table   = t;
+        indices = tableIndices;
+      }
+    }
+    return best;
+  }
+
+  static void EncodeEtc1Block(const BlockPixels& pixels, std::uint8_t* out)
+  {
+    int bestError = std::numeric_limits<int>::max();
+
+    for (const bool flip : {false, true}) {
+      float average[2][3] = {};
+      for (int p = 0; p < 16; ++p) {
+        for (int c = 0; c < 3; ++c)
+          average[SubBlock(p, flip)][c] += pixels[p][c] / 8.0f;
+      }
+
+      // The differential mode has 5 bits colors, the second one within
+      // [-4, 3] of the first. The individual mode has two 4 bits colors.
+      int  quantized[2][3];
+      bool differential = true;
+      for (int c = 0; c < 3; ++c) {
+        for (int s = 0; s < 2; ++s)
+          quantized[s][c] = (int)std::lround(average[s][c] * 31.0f / 255.0f);
+        const int delta = quantized[1][c] - quantized[0][c];
+        if (delta < -4 || delta > 3) differential = false;
+      }
+
+      for (const bool mode : {true, false}) {
+        if (mode && differential == false) continue;
+
+        std::uint8_t block[8] = {};
+        int          base[2][3];
+        for (int c = 0; c < 3; ++c) {
+          if (mode) {
+            for (int s = 0; s < 2; ++s)
+              base[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+            block[c] = (quantized[0][c] << 3) |
+                       ((quantized[1][c] - quantized[0][c]) & 0x7);
+          } else {
+            int q[2];
+            for (int s = 0; s < 2; ++s) {
+              q[s]       = (int)std::lround(average[s][c] * 15.0f / 255.0f);
+              base[s][c] = q[s] * 17;
+            }
+            block[c] = (q[0] << 4) | q[1];
+          }
+        }
+
+        int           tables[2]  = {0, 0};
+        std::uint32_t indices[2] = {0, 0};
+        const int     error =
+          FitSubBlock(pixels, 0, flip, base[0], tables[0], indices[0]) +
+          FitSubBlock(pixels, 1, flip, base[1], tables[1], indices[1]);
+        if (error >= bestError) continue;
+
+        // The sub blocks cover distinct pixels, their indices do not overlap
+        const std::uint32_t all = indices[0] | indices[1];
+        std::uint32_t       msb = 0;
+        std::uint32_t       lsb = 0;
+        for (int p = 0; p < 16; ++p) {
+          msb |= ((all >> (2 * p + 1)) & 1) << p;
+          lsb |= ((all >> (2 * p)) & 1) << p;
+        }
+        block[3] = (tables[0] << 5) | (tables[1] << 2) | (mode << 1) | flip;
+        block[4] = msb >> 8;
+        block[5] = msb & 0xFF;
+        block[6] = lsb >> 8;
+        block[7] = lsb & 0xFF;
+
+        bestError = error;
+        std::memcpy(out, block, sizeof(block));
+      }
+    }
+  }
+
+  static KtxTexture::Level EncodeEtc1Level(
+    const std::vector<std::uint8_t>& rgba, const int width, const int height)
+  {
+    const int         blocksX = (width + 3) / 4;
+    const int         blocksY = (height + 3) / 4;
+    KtxTexture::Level level   = {width, height, {}};
+    level.data.resize(blocksX * blocksY * 8);
+
+    for (int by = 0; by < blocksY; ++by) {
+      for (int bx = 0; bx < blocksX; ++bx) {
+        BlockPixels pixels;
+
+        // The blocks past the edges repeat the last pixels of the image
+        for (int p = 0; p < 16; ++p) {
+          const int x = std::min(bx * 4 + p / 4, width - 1);
+          const int y = std::min(by * 4 + p % 4, height - 1);
+          for (int c = 0; c < 3; ++c)
+            pixels[p][c] = rgba[(y * width + x) * 4 + c];
+        }
+        EncodeEtc1Block(pixels, &level.data[(by * blocksX + bx) * 8]);
+      }
+    }
+    return level;
+  }
+
+  /**
+   * Next level of the mip chain, each pixel averaging (up to) 2x2 pixels
+   */
+  static std::vector<std::uint8_t> Downsample(
+    const std::vector<std::uint8_t>& rgba, const int width, const int height)
+  {
+    const int                 w = std::max(1, width / 2);
+    const int                 h = std::max(1, height / 2);
+    std::vector<std::uint8_t> result(w * h * 4);
+
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        const int x0 = std::min(2 * x, width - 1);
+        const int x1 = std::min(2 * x + 1, width - 1);
+        const int y0 = std::min(2 * y, height - 1);
+        const int y1 = std::min(2 * y + 1, height - 1);
+
+        for (int c = 0; c < 4; ++c) {
+          const int sum =
+            rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c] +
+            rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c];
+          result[(y * w + x) * 4 + c] = static_cast<std::uint8_t>(sum / 4);
+        }
+      }
+    }
+    return result;
+  }
+
+  KtxTexture KtxTexture::EncodeEtc1(const std::uint8_t* rgba, const int width,
+                                    const int height)
+  {
+    KtxTexture texture;
+    texture.internalFormat = GL_ETC1_RGB8_OES;
+    texture.baseFormat     = GL_RGB;
+
+    std::vector<std::uint8_t> image(rgba, rgba + width * height * 4);
+    int                       w = width;
+    int                       h = height;
+    for (;;) {
+      texture.levels.push_back(EncodeEtc1Level(image, w, h));
+      if (w == 1 && h == 1) break;
+
+      image = Downsample(image, w, h);
+      w     = std::max(1, w / 2);
+      h     = std::max(1, h / 2);
+    }
+    return texture;
+  }
+
+  std::vector<std::uint8_t> KtxTexture::serialize(void) const
+  {
+    std::vector<std::uint8_t> out(KtxIdentifier,
+                                  KtxIdentifier + sizeof(KtxIdentifier));
+    const auto write = [&out](const std::uint32_t value) {
+      const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(value));
+    };
+
+    const GLsizei width  = levels.empty() ? 0 : levels.front().width;
+    const GLsizei height = levels.empty() ? 0 : levels.front().height;
+    // Compressed: no type, no format, a type size of 1
+    for (const std::uint32_t value :
+         {KtxEndianness, 0u, 1u, 0u, (std::uint32_t)internalFormat,
+          (std::uint32_t)baseFormat, (std::uint32_t)width,
+          (std::uint32_t)height, 0u, 0u, 1u, (std::uint32_t)levels.size(),
+          0u}) {
+      write(value);
+    }
+
+    for (const Level& level : levels) {
+      write(level.data.size());
+      out.insert(out.end(), level.data.begin(), level.data.end());
+      out.resize((out.size() + 3) & ~std::size_t(3), 0);
+    }
+    return out;
+  }
+
+  bool KtxTexture::Deserialize(const std::vector<std::uint8_t>& content,
+                               KtxTexture&                      texture)
+  {
+    std::size_t offset = sizeof(KtxIdentifier);
+    const auto  word   = [&](std::uint32_t& value) {
+      if (offset + sizeof(value) > content.size()) return false;
+      std::memcpy(&value, content.data() + offset, sizeof(value));
+      offset += sizeof(value);
+      return true;
+    };
+
+    if (content.size() < sizeof(KtxIdentifier) ||
+        std::memcmp(content.data(), KtxIdentifier, sizeof(KtxIdentifier)) != 0)
+      return false;
+
+    std::uint32_t header[13];
+    for (std::uint32_t& value : header) {
+      if (word(value) == false) return false;
+    }
+    const std::uint32_t endianness = header[0];
+    const std::uint32_t type       = header[1];
+    const std::uint32_t width      = header[6];
+    const std::uint32_t height     = header[7];
+    const std::uint32_t depth      = header[8];
+    const std::uint32_t elements   = header[9];
+    const std::uint32_t faces      = header[10];
+    const std::uint32_t mipmaps    = std::max<std::uint32_t>(1, header[11]);
+    const std::uint32_t keyValues  = header[12];
+
+    // Written on the same endianness, the files are built for one platform
+    if (endianness != KtxEndianness || type != 0 || width == 0 ||
+        height == 0 || depth != 0 || elements != 0 || faces != 1 ||
+        keyValues > content.size() - offset)
+      return false;
+    offset += keyValues;
+
+    KtxTexture read;
+    read.internalFormat = header[4];
+    read.baseFormat     = header[5];
+    for (std::uint32_t i = 0; i < mipmaps; ++i) {
+      std::uint32_t size = 0;
+      if (word(size) == false || size > content.size() - offset) return false;
+
+      Level level;
+      level.width  = std::max<GLsizei>(1, width >> i);
+      level.height = std::max<GLsizei>(1, height >> i);
+      level.data.assign(content.begin() + offset,
+                        content.begin() + offset + size);
+      read.levels.push_back(std::move(level));
+      offset = (offset + size + 3) & ~std::size_t(3);
+    }
+
+    texture = std::move(read);
+    return true;
+  }
+
+} // Soleil
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SOLEIL__KTX_HPP_
+#define SOLEIL__KTX_HPP_
+
+#include "OpenGLInclude.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace Soleil {
+
+  /**
+   * Compressed 2D texture with its mip chain, as stored in a KTX (version 1)
+   * file. The levels are ready for glCompressedTexImage2D.
+   */
+  struct KtxTexture
+  {
+    struct Level
+    {
+      GLsizei                   width;
+      GLsizei                   height;
+      std::vector<std::uint8_t> data;
+    };
+
+    GLenum             internalFormat;
+    GLenum             baseFormat;
+    std::vector<Level> levels; // From the full size one down to 1x1
+
+    /**
+     * Compress an opaque RGBA image in ETC1 (GL_ETC1_RGB8_OES), with its mip
+     * chain. The rows are kept in their order, the first one is at t = 0.
+     */
+    static KtxTexture EncodeEtc1(const std::uint8_t* rgba, const int width,
+                                 const int height);
+
+    std::vector<std::uint8_t> serialize(void) const;
+
+    /**
+     * Read a file written by serialize. Return false if the content is not
+     * a valid 2D compressed KTX texture.
+     */
+    static bool Deserialize(const std::vector<std::uint8_t>& content,
+                            KtxTexture&                      texture);
+  };
+
+} // Soleil
+
+#endif /* SOLEIL__KTX_HPP_ */
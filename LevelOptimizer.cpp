@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "LevelOptimizer.hpp"
+#include "Culling.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace Soleil {
+
+  /**
+   * Tolerance on positions, relative to the size of the model
+   */
+  static constexpr float PositionEpsilon = 1e-3f;
+
+  /**
+   * Tolerance on the texture coordinates. Exported models are rarely exactly
+   * mapped to [0, 1].
+   */
+  static constexpr float UVEpsilon = 2e-2f;
+
+  bool CubeModel::FromSubShapes(const std::vector<SubShape>& subShapes,
+                                CubeModel&                   model)
+  {
+    model.min = glm::vec3(std::numeric_limits<float>::max());
+    model.max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const auto& sub : subShapes) {
+      for (const auto& vertex : sub.vertices) {
+        model.min = glm::min(model.min, glm::vec3(vertex.position));
+        model.max = glm::max(model.max, glm::vec3(vertex.position));
+      }
+    }
+
+    const glm::vec3 size = model.size();
+    if (size.x <= 0.0f || size.y <= 0.0f || size.z <= 0.0f) return false;
+
+    const float epsilon = PositionEpsilon * std::max({size.x, size.y, size.z});
+    bool        found[6] = {false, false, false, false, false, false};
+    float       area[6]  = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (std::size_t s = 0; s < subShapes.size(); ++s) {
+      const SubShape& sub = subShapes[s];
+
+      for (std::size_t i = 0; i + 2 < sub.indices.size(); i += 3) {
+        const Vertex* triangle[3] = {&sub.vertices[sub.indices[i]],
+                                     &sub.vertices[sub.indices[i + 1]],
+                                     &sub.vertices[sub.indices[i + 2]]};
+        const glm::vec3 p0(triangle[0]->position);
+        const glm::vec3 p1(triangle[1]->position);
+        const glm::vec3 p2(triangle[2]->position);
+
+        glm::vec3   normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        if (length <= 0.0f) continue; // Degenerated triangle
+        normal /= length;
+
+        int axis = 0;
+        if (glm::abs(normal.y) > glm::abs(normal[axis])) axis = 1;
+        if (glm::abs(normal.z) > glm::abs(normal[axis])) axis = 2;
+        if (glm::abs(normal[axis]) < 1.0f - PositionEpsilon) return false;
+
+        const bool  positive = normal[axis] > 0.0f;
+        const float plane    = positive ? model.max[axis] : model.min[axis];
+        const int   u        = (axis + 1) % 3;
+        const int   v        = (axis + 2) % 3;
+
+        glm::vec2 coordinates[3];
+        for (int c = 0; c < 3; ++c) {
+          const glm::vec4& p = triangle[c]->position;
+          if (glm::abs(p[axis] - plane) > epsilon) return false;
+
+          coordinates[c] = glm::vec2((p[u] - model.min[u]) / size[u],
+                                     (p[v] - model.min[v]) / size[v]);
+        }
+
+        const int side  = axis * 2 + (positive ? 1 : 0);
+        Side&     mSide = model.sides[side];
+        if (found[side] == false) {
+          // Solve the affine mapping from the first triangle of the side
+          const glm::vec2 d1  = coordinates[1] - coordinates[0];
+          const glm::vec2 d2  = coordinates[2] - coordinates[0];
+          const glm::vec2 uv1 = triangle[1]->uv - triangle[0]->uv;
+          const glm::vec2 uv2 = triangle[2]->uv - triangle[0]->uv;
+          const float     det = d1.x * d2.y - d1.y * d2.x;
+          if (glm::abs(det) <= PositionEpsilon) return false;
+
+          mSide.subShape = s;
+          mSide.color    = triangle[0]->color;
+          mSide.uvU      = (uv1 * d2.y - uv2 * d1.y) / det;
+          mSide.uvV      = (uv2 * d1.x - uv1 * d2.x) / det;
+          mSide.uvOrigin = triangle[0]->uv - coordinates[0].x * mSide.uvU -
+                           coordinates[0].y * mSide.uvV;
+          found[side] = true;
+        } else if (mSide.subShape != s) {
+          return false;
+        }
+
+        for (int c = 0; c < 3; ++c) {
+          const glm::vec2 expected = mSide.uvOrigin +
+                                     coordinates[c].x * mSide.uvU +
+                                     coordinates[c].y * mSide.uvV;
+          if (glm::length(expected - triangle[c]->uv) > UVEpsilon) return false;
+        }
+
+        area[side] += length / 2.0f;
+      }
+    }
+
+    // Each side must be fully covered
+    for (int side = 0; side < 6; ++side) {
+      const int   axis     = side / 2;
+      const float expected = size[(axis + 1) % 3] * size[(axis + 2) % 3];
+
+      if (found[side] == false ||
+          glm::abs(area[side] - expected) > expected * UVEpsilon)
+        return false;
+    }
+    return true;
+  }
+
+  bool GridCell(const glm::mat4& transformation, const CubeModel& model,
+                glm::ivec3& cell)
+  {
+    // No rotation nor scale
+    for (int x = 0; x < 3; ++x) {
+      for (int y = 0; y < 4; ++y) {
+        const float expected = (x == y) ? 1.0f : 0.0f;
+        if (glm::abs(transformation[x][y] - expected) > PositionEpsilon)
+          return false;
+      }
+    }
+    if (glm::abs(transformation[3][3] - 1.0f) > PositionEpsilon) return false;
+
+    const glm::vec3 size = model.size();
+    for (int i = 0; i < 3; ++i) {
+      const float position = transformation[3][i] / size[i];
+      const float rounded  = glm::round(position);
+
+      if (glm::abs(position - rounded) > PositionEpsilon) return false;
+      cell[i] = static_cast<int>(rounded);
+    }
+    return true;
+  }
+
+  std::vector<SubShape> MergeGridCubes(const std::vector<glm::ivec3>& cells,
+                                       const CubeModel&               model,
+                                       const std::vector<SubShape>& subShapes)
+  {
+    constexpr int max = std::numeric_limits<int>::max();
+    constexpr int min = std::numeric_limits<int>::min();
+
+    return MergeGridCubes(cells, model, subShapes, glm::ivec3(min),
+                          glm::ivec3(max));
+  }
+
+  std::vector<SubShape> MergeGridCubes(const std::vector<glm::ivec3>& cells,
+                                       const CubeModel&               model,
+                                       const std::vector<SubShape>& subShapes,
+                                       const glm::ivec3&            from,
+                                       const glm::ivec3&            to)
+  {
+    constexpr std::size_t maxVertices = std::numeric_limits<GLushort>::max() + 1;
+    constexpr std::size_t none        = std::numeric_limits<std::size_t>::max();
+    std::vector<SubShape> result;
+
+    if (cells.empty()) return result;
+
+    glm::ivec3 lo = cells.front();
+    glm::ivec3 hi = cells.front();
+    for (const auto& cell : cells) {
+      lo = glm::min(lo, cell);
+      hi = glm::max(hi, cell);
+    }
+    const glm::ivec3 dimensions = hi - lo + 1;
+
+    std::vector<char> grid(dimensions.x * dimensions.y * dimensions.z, 0);
+    const auto        offset = [&dimensions](const glm::ivec3& c) {
+      return (c.z * dimensions.y + c.y) * dimensions.x + c.x;
+    };
+    const auto occupied = [&](const glm::ivec3& c) {
+      if (glm::any(glm::lessThan(c, glm::ivec3(0))) ||
+          glm::any(glm::greaterThanEqual(c, dimensions)))
+        return false;
+      return grid[offset(c)] != 0;
+    };
+    for (const auto& cell : cells) {
+      grid[offset(cell - lo)] = 1;
+    }
+
+    // Index in result of the SubShape being filled for each material
+    std::vector<std::size_t> current(subShapes.size(), none);
+    const glm::vec3          size = model.size();
+
+    for (int side = 0; side < 6; ++side) {
+      const CubeModel::Side& mSide    = model.sides[side];
+      const int              axis     = side / 2;
+      const bool             positive = (side % 2) == 1;
+      const int              u        = (axis + 1) % 3;
+      const int              v        = (axis + 2) % 3;
+
+      glm::ivec3 step(0);
+      step[axis] = positive ? 1 : -1;
+      glm::vec3 normal(0.0f);
+      normal[axis] = positive ? 1.0f : -1.0f;
+
+      std::vector<char> mask(dimensions[u] * dimensions[v]);
+      for (int k = 0; k < dimensions[axis]; ++k) {
+        // Sides of this slice not hidden by a neighbour
+        for (int j = 0; j < dimensions[v]; ++j) {
+          for (int i = 0; i < dimensions[u]; ++i) {
+            glm::ivec3 c;
+            c[axis] = k;
+            c[u]    = i;
+            c[v]    = j;
+
+            const glm::ivec3 cell = c + lo;
+            const bool inside = glm::all(glm::greaterThanEqual(cell, from)) &&
+                                glm::all(glm::lessThanEqual(cell, to));
+
+            mask[j * dimensions[u] + i] =
+              inside && occupied(c) && !occupied(c + step);
+          }
+        }
+
+        // Greedy merge: widest run along u first, then as many rows as
+        // possible along v
+        for (int j = 0; j < dimensions[v]; ++j) {
+          for (int i = 0; i < dimensions[u]; ++i) {
+            if (mask[j * dimensions[u] + i] == 0) continue;
+
+            int w = 1;
+            while (i + w < dimensions[u] && mask[j * dimensions[u] + i + w])
+              ++w;
+
+            int h = 1;
+            for (; j + h < dimensions[v]; ++h) {
+              const auto row = mask.begin() + (j + h) * dimensions[u] + i;
+              if (std::find(row, row + w, 0) != row + w) break;
+            }
+
+            for (int y = j; y < j + h; ++y) {
+              std::fill_n(mask.begin() + y * dimensions[u] + i, w, 0);
+            }
+
+            // Emit the quad
+            std::size_t& index = current[mSide.subShape];
+            if (index == none ||
+                result[index].vertices.size() + 4 > maxVertices) {
+              result.emplace_back();
+              result.back().material = subShapes[mSide.subShape].material;
+              index                  = result.size() - 1;
+            }
+            SubShape& quads = result[index];
+
+            const float plane = (lo[axis] + k) * size[axis] +
+                                (positive ? model.max[axis] : model.min[axis]);
+            const float startU   = (lo[u] + i) * size[u] + model.min[u];
+            const float startV   = (lo[v] + j) * size[v] + model.min[v];
+            const float corners[4][2] = {{0.0f, 0.0f},
+                                         {static_cast<float>(w), 0.0f},
+                                         {static_cast<float>(w),
+                                          static_cast<float>(h)},
+                                         {0.0f, static_cast<float>(h)}};
+
+            const GLushort base = static_cast<GLushort>(quads.vertices.size());
+            for (const auto& corner : corners) {
+              glm::vec4 position(0.0f, 0.0f, 0.0f, 1.0f);
+              position[axis] = plane;
+              position[u]    = startU + corner[0] * size[u];
+              position[v]    = startV + corner[1] * size[v];
+
+              const glm::vec2 uv = mSide.uvOrigin + corner[0] * mSide.uvU +
+                                   corner[1] * mSide.uvV;
+              quads.vertices.emplace_back(position, normal, mSide.color, uv);
+            }
+
+            // Counter-clockwise as seen from outside the cube
+            const GLushort order[2][6] = {{0, 3, 2, 2, 1, 0},
+                                          {0, 1, 2, 2, 3, 0}};
+            for (GLushort o : order[positive ? 1 : 0]) {
+              quads.indices.push_back(base + o);
+            }
+          }
+        }
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Merge the consecutive boxes along the axis when they have the same extent
+   * on the two others.
+   */
+  static void MergeBoundingBoxesAlong(std::vector<BoundingBox>& boxes,
+                                      const int                 axis)
+  {
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+
+    std::sort(boxes.begin(), boxes.end(),
+              [u, v, axis](const BoundingBox& a, const BoundingBox& b) {
+                const glm::vec3& aMin = a.getMin();
+                const glm::vec3& aMax = a.getMax();
+                const glm::vec3& bMin = b.getMin();
+                const glm::vec3& bMax = b.getMax();
+
+                if (aMin[u] != bMin[u]) return aMin[u] < bMin[u];
+                if (aMax[u] != bMax[u]) return aMax[u] < bMax[u];
+                if (aMin[v] != bMin[v]) return aMin[v] < bMin[v];
+                if (aMax[v] != bMax[v]) return aMax[v] < bMax[v];
+                return aMin[axis] < bMin[axis];
+              });
+
+    std::vector<BoundingBox> merged;
+    merged.reserve(boxes.size());
+    for (const auto& box : boxes) {
+      if (merged.empty() == false) {
+        BoundingBox&     last    = merged.back();
+        const glm::vec3& min     = box.getMin();
+        const glm::vec3& max     = box.getMax();
+        const glm::vec3& lastMin = last.getMin();
+        const glm::vec3& lastMax = last.getMax();
+
+        if (glm::abs(min[u] - lastMin[u]) <= PositionEpsilon &&
+            glm::abs(max[u] - lastMax[u]) <= PositionEpsilon &&
+            glm::abs(min[v] - lastMin[v]) <= PositionEpsilon &&
+            glm::abs(max[v] - lastMax[v]) <= PositionEpsilon &&
+            min[axis] <= lastMax[axis] + PositionEpsilon) {
+          last.expandBy(box);
+          continue;
+        }
+      }
+      merged.push_back(box);
+    }
+    boxes.swap(merged);
+  }
+
+  void BakeLighting(SubShape& sub, const glm::vec3& ambient,
+                    const std::vector<PointLight>& lights)
+  {
+    const Material& material = sub.material;
+
+    for (Vertex& v : sub.vertices) {
+      const glm::vec3 position = glm::vec3(v.position);
+      glm::vec3       light    = ambient + material.emissiveColor;
+
+      for (const PointLight& pointLight : lights) {
+        const glm::vec3 direction = pointLight.position - position;
+        const float     distance  = glm::length(direction);
+        if (distance <= 0.0f) continue;
+
+        const float diffuse =
+          glm::max(0.0f, glm::dot(v.normal, direction / distance));
+        light += material.diffuseColor * pointLight.color * diffuse *
+                 LightAttenuation(pointLight, distance);
+      }
+      v.color = glm::vec4(
+        glm::clamp(light / BakedLightRange, glm::vec3(0.0f), glm::vec3(1.0f)),
+        1.0f);
+    }
+    sub.material.features |= MaterialFeature::BakedLight;
+  }
+
+  void MergeBoundingBoxes(std::vector<BoundingBox>& boxes)
+  {
+    // Rows along x, then rows of equal length along z, then the stacks
+    MergeBoundingBoxesAlong(boxes, 0);
+    MergeBoundingBoxesAlong(boxes, 2);
+    MergeBoundingBoxesAlong(boxes, 1);
+  }
+
+} // Soleil
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SOLEIL__LEVELOPTIMIZER_HPP_
+#define SOLEIL__LEVELOPTIMIZER_HPP_
+
+#include "BoundingBox.hpp"
+#include "Shape.hpp"
+#include "types.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+namespace Soleil {
+
+  /**
+   * Geometry of a box model whose six sides are axis-aligned quads, each one
+   * mapped to its texture with an affine function.
+   */
+  struct CubeModel
+  {
+    struct Side
+    {
+      std::size_t subShape; // SubShape holding the material of the side
+      glm::vec4   color;
+      glm::vec2   uvOrigin; // uv at the (min, min) corner
+      glm::vec2   uvU;      // uv step of one side length along the u axis
+      glm::vec2   uvV;      // uv step of one side length along the v axis
+    };
+
+    glm::vec3 min;
+    glm::vec3 max;
+    Side      sides[6]; // -x, +x, -y, +y, -z, +z
+
+    /**
+     * Extract the sides of the model. Return false if the model is not such a
+     * box (other faces, non-planar sides, ...).
+     */
+    static bool FromSubShapes(const std::vector<SubShape>& subShapes,
+                              CubeModel&                   model);
+
+    glm::vec3 size(void) const noexcept { return max - min; }
+  };
+
+  /**
+   * Return true if the transformation only translates the model onto a cell of
+   * the grid, whose cells are as large as the model. The cell index is set in
+   * this case.
+   */
+  bool GridCell(const glm::mat4& transformation, const CubeModel& model,
+                glm::ivec3& cell);
+
+  /**
+   * Build the geometry of the cubes laid on the given cells: the sides shared
+   * by two cubes are removed and the coplanar sides are greedily merged in
+   * larger quads whose texture repeats once per cube. The geometry is in world
+   * space, with one SubShape per material.
+   */
+  std::vector<SubShape> MergeGridCubes(const std::vector<glm::ivec3>& cells,
+                                       const CubeModel&               model,
+                                       const std::vector<SubShape>& subShapes);
+
+  /**
+   * Same as above, only building the sides of the cubes within the cells
+   * [from, to]. The cubes outside still hide the sides of their neighbours.
+   */
+  std::vector<SubShape> MergeGridCubes(const std::vector<glm::ivec3>& cells,
+                                       const CubeModel&               model,
+                                       const std::vector<SubShape>& subShapes,
+                                       const glm::ivec3&            from,
+                                       const glm::ivec3&            to);
+
+  /**
+   * Light the vertices of the SubShape, in world space, as flatshape.vert
+   * would with the ambient light and the fixed lights but without their
+   * specular part. The light is kept in the vertex colors and the material is
+   * flagged MaterialFeature::BakedLight, so only the moving lights are left to
+   * the shaders.
+   */
+  void BakeLighting(SubShape& sub, const glm::vec3& ambient,
+                    const std::vector<PointLight>& lights);
+
+  /**
+   * Merge the boxes that are adjacent and can be joined in a single box.
+   * Regions covered are left unchanged.
+   */
+  void MergeBoundingBoxes(std::vector<BoundingBox>& boxes);
+
+} // Soleil
+
+#endif /* SOLEIL__LEVELOPTIMIZER_HPP_ */
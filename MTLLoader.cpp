@@ -60,25 +60,44 @@ namespace Soleil {
     s >> *value;
   }
 
-  static void commandLoadTexture(GLint*             textureMaterial,
-                                 const std::string& argument)
+  /**
+   * Fill the bound texture with a diffuse map, repeated over the model
+   */
+  static void UploadDiffuseMap(const std::string& assetName)
   {
-    const ImageAsset image(argument);
-
-    // TODO: Might be directly in the shape
-    OpenGLDataInstance::Instance().textures.emplace_back();
-
-    gl::Texture&    texture = OpenGLDataInstance::Instance().textures.back();
-    gl::BindTexture bindTexture(GL_TEXTURE_2D, *texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    if (AssetService::LoadCompressedTexture(assetName, true) == false) {
+      const ImageAsset image(assetName);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+      glGenerateMipmap(GL_TEXTURE_2D);
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glGenerateMipmap(GL_TEXTURE_2D);
+  }
 
-    *textureMaterial = *texture;
+  static void commandLoadTexture(Material*          material,
+                                 const std::string& argument)
+  {
+    material->texture = OpenGLDataInstance::Instance().textures.get(
+      argument, UploadDiffuseMap);
+    material->diffuseMap = **material->texture;
+    material->features |= MaterialFeature::Textured;
+  }
+
+  static void commandParseOpacity(Material* material, const std::string& line)
+  {
+    commandParseFloat(&material->opacity, line);
+    if (material->opacity < 1.0f)
+      material->features |= MaterialFeature::AlphaBlend;
+  }
+
+  static void commandAlphaMap(Material* material, const std::string& argument)
+  {
+    // The alpha is read from the diffuse map, the one of map_d is not loaded
+    SOLEIL__LOGGER_DEBUG("Alpha of the diffuse map used for map_d ", argument);
+    material->features |= MaterialFeature::AlphaBlend;
   }
 
   static void commandPushMaterial(std::map<std::string, Material>* materials,
@@ -117,13 +136,18 @@ namespace Soleil {
     });
     commandMap->emplace(
       "map_Kd", [materials, argument](const std::string& line) {
-        commandLoadTexture(&(materials->at(argument).diffuseMap), line);
+        commandLoadTexture(&(materials->at(argument)), line);
       });
 
     commandMap->emplace(
       "Ni", [](const std::string& line) { commandNOOP("Ni", line); });
+    commandMap->emplace("d", [materials, argument](const std::string& line) {
+      commandParseOpacity(&(materials->at(argument)), line);
+    });
     commandMap->emplace(
-      "d", [](const std::string& line) { commandNOOP("Ni", line); });
+      "map_d", [materials, argument](const std::string& line) {
+        commandAlphaMap(&(materials->at(argument)), line);
+      });
     commandMap->emplace(
       "illum", [](const std::string& line) { commandNOOP("Ni", line); });
     commandMap->emplace(
@@ -22,12 +22,43 @@
 #include "OpenGLDataInstance.hpp"
 
 #include "AssetService.hpp"
+#include "Font.hpp"
+#include "Logger.hpp"
+#include "Shape.hpp"
+#include "StateCache.hpp"
 #include "Text.hpp"
 
+#include <chrono>
+
 namespace Soleil {
 
   std::unique_ptr<OpenGLDataInstance> OpenGLDataInstance::instance;
 
+#define SOLEIL__POINTLIGHT_UNIFORMS(i)                                         \
+  {                                                                            \
+    "pointLight[" #i "].position", "pointLight[" #i "].color",                 \
+      "pointLight[" #i "].linearAttenuation",                                  \
+      "pointLight[" #i "].quadraticAttenuation"                                \
+  }
+
+  /**
+   * Names of the fields of pointLight[i], in the order of DrawablePointLight
+   */
+  static const char* const PointLightUniforms[DefinedMaxLights][4] = {
+    SOLEIL__POINTLIGHT_UNIFORMS(0),  SOLEIL__POINTLIGHT_UNIFORMS(1),
+    SOLEIL__POINTLIGHT_UNIFORMS(2),  SOLEIL__POINTLIGHT_UNIFORMS(3),
+    SOLEIL__POINTLIGHT_UNIFORMS(4),  SOLEIL__POINTLIGHT_UNIFORMS(5),
+    SOLEIL__POINTLIGHT_UNIFORMS(6),  SOLEIL__POINTLIGHT_UNIFORMS(7),
+    SOLEIL__POINTLIGHT_UNIFORMS(8),  SOLEIL__POINTLIGHT_UNIFORMS(9),
+    SOLEIL__POINTLIGHT_UNIFORMS(10), SOLEIL__POINTLIGHT_UNIFORMS(11),
+    SOLEIL__POINTLIGHT_UNIFORMS(12), SOLEIL__POINTLIGHT_UNIFORMS(13),
+    SOLEIL__POINTLIGHT_UNIFORMS(14), SOLEIL__POINTLIGHT_UNIFORMS(15),
+  };
+  static_assert(DefinedMaxLights == 16, "One name per light");
+  static_assert(LightSet::Max <= DefinedMaxLights, "One name per light");
+
+#undef SOLEIL__POINTLIGHT_UNIFORMS
+
   static inline void initializeDrawable()
   {
     OpenGLDataInstance& instance = OpenGLDataInstance::Instance();
@@ -36,10 +67,10 @@ namespace Soleil {
     drawable.attachShader(Shader(GL_VERTEX_SHADER, "shape.vert"));
     drawable.attachShader(Shader(GL_FRAGMENT_SHADER, "shape.frag"));
 
-    glBindAttribLocation(drawable.program, 0, "positionAttribute");
-    glBindAttribLocation(drawable.program, 1, "normalAttribute");
-    glBindAttribLocation(drawable.program, 2, "colorAttribute");
-    glBindAttribLocation(drawable.program, 3, "uvAttribute");
+    drawable.bindAttribLocation(0, "positionAttribute");
+    drawable.bindAttribLocation(1, "normalAttribute");
+    drawable.bindAttribLocation(2, "colorAttribute");
+    drawable.bindAttribLocation(3, "uvAttribute");
 
     drawable.compile();
 
@@ -60,67 +91,113 @@ namespace Soleil {
       drawable.getUniform("material.specularColor");
     instance.drawableMaterial.diffuseMap =
       drawable.getUniform("material.diffuseMap");
+    instance.drawableMaterial.opacity = -1;
 
     instance.drawableAmbiantLight = drawable.getUniform("AmbiantLight");
     instance.drawableEyeDirection = drawable.getUniform("EyeDirection");
     for (int i = 0; i < DefinedMaxLights; ++i) {
-      instance.drawablePointLights[i].position =
-        drawable.getUniform(toString("pointLight[", i, "].position").data());
-      instance.drawablePointLights[i].color =
-        drawable.getUniform(toString("pointLight[", i, "].color").data());
-      instance.drawablePointLights[i].linearAttenuation = drawable.getUniform(
-        toString("pointLight[", i, "].linearAttenuation").data());
-      instance.drawablePointLights[i].quadraticAttenuation =
-        drawable.getUniform(
-          toString("pointLight[", i, "].quadraticAttenuation").data());
+      const char* const*  names = PointLightUniforms[i];
+      DrawablePointLight& light = instance.drawablePointLights[i];
+
+      light.position             = drawable.getUniform(names[0]);
+      light.color                = drawable.getUniform(names[1]);
+      light.linearAttenuation    = drawable.getUniform(names[2]);
+      light.quadraticAttenuation = drawable.getUniform(names[3]);
     }
   }
 
-  static inline void initializeFlatShape()
+  static inline void initializeFlatShape(FlatShape&         shape,
+                                         const FlatShapeKey key)
   {
-    OpenGLDataInstance& instance = OpenGLDataInstance::Instance();
-    Program&            flat     = instance.flat.program;
-
-    flat.attachShader(Shader(GL_VERTEX_SHADER, "flatshape.vert"));
-    flat.attachShader(Shader(GL_FRAGMENT_SHADER, "flatshape.frag"));
-
-    glBindAttribLocation(flat.program, 0, "positionAttribute");
-    glBindAttribLocation(flat.program, 1, "normalAttribute");
-    glBindAttribLocation(flat.program, 2, "colorAttribute");
-    glBindAttribLocation(flat.program, 3, "uvAttribute");
+    const std::uint8_t features   = key & 0xFF;
+    const bool         instanced  = (key >> 8) & 0xFF;
+    const int          lightCount = (key >> 16) & 0xFF;
+
+    std::vector<std::string> defines;
+    if (features & MaterialFeature::Textured) defines.push_back("TEXTURED");
+    if (features & MaterialFeature::AlphaBlend)
+      defines.push_back("ALPHA_BLEND");
+    if (features & MaterialFeature::BakedLight)
+      defines.push_back("BAKED_LIGHT");
+    if (instanced) defines.push_back("INSTANCED");
+    defines.push_back(toString("LIGHT_COUNT ", lightCount));
+
+    Program& flat = shape.program;
+
+    flat.attachShader(Shader(GL_VERTEX_SHADER, "flatshape.vert", defines));
+    flat.attachShader(Shader(GL_FRAGMENT_SHADER, "flatshape.frag", defines));
+
+    flat.bindAttribLocation(0, "positionAttribute");
+    flat.bindAttribLocation(1, "normalAttribute");
+    flat.bindAttribLocation(2, "colorAttribute");
+    flat.bindAttribLocation(3, "uvAttribute");
+    if (instanced) {
+      // Takes 4 to 7
+      flat.bindAttribLocation(4, "modelAttribute");
+    }
 
     flat.compile();
 
-    instance.flat.MVPMatrix      = flat.getUniform("MVPMatrix");
-    instance.flat.MVMatrix       = flat.getUniform("MVMatrix");
-    instance.flat.NormalMatrix   = flat.getUniform("NormalMatrix");
-    instance.flat.NumberOfLights = flat.getUniform("numberOfLights");
-
-    instance.flat.Material.ambiantColor =
-      flat.getUniform("material.ambiantColor");
-    instance.flat.Material.shininess = flat.getUniform("material.shininess");
-    instance.flat.Material.emissiveColor =
-      flat.getUniform("material.emissiveColor");
-    instance.flat.Material.diffuseColor =
-      flat.getUniform("material.diffuseColor");
-    instance.flat.Material.specularColor =
-      flat.getUniform("material.specularColor");
-    instance.flat.Material.diffuseMap = flat.getUniform("material.diffuseMap");
-
-    instance.flat.AmbiantLight = flat.getUniform("AmbiantLight");
-    instance.flat.EyeDirection = flat.getUniform("EyeDirection");
-    for (int i = 0; i < DefinedMaxLights; ++i) {
-      instance.flat.PointLights[i].position =
-        flat.getUniform(toString("pointLight[", i, "].position").data());
-      instance.flat.PointLights[i].color =
-        flat.getUniform(toString("pointLight[", i, "].color").data());
-      instance.flat.PointLights[i].linearAttenuation = flat.getUniform(
-        toString("pointLight[", i, "].linearAttenuation").data());
-      instance.flat.PointLights[i].quadraticAttenuation = flat.getUniform(
-        toString("pointLight[", i, "].quadraticAttenuation").data());
+    if (instanced) {
+      shape.MVPMatrix    = -1;
+      shape.MVMatrix     = -1;
+      shape.NormalMatrix = -1;
+      shape.VPMatrix     = flat.getUniform("VPMatrix");
+    } else {
+      shape.MVPMatrix    = flat.getUniform("MVPMatrix");
+      shape.MVMatrix     = flat.getUniform("MVMatrix");
+      shape.NormalMatrix = flat.getUniform("NormalMatrix");
+      shape.VPMatrix     = -1;
+    }
+
+    // Depending on the variant, the compiler may leave those out
+    shape.Material.ambiantColor  = flat.findUniform("material.ambiantColor");
+    shape.Material.shininess     = flat.findUniform("material.shininess");
+    shape.Material.emissiveColor = flat.findUniform("material.emissiveColor");
+    shape.Material.diffuseColor  = flat.findUniform("material.diffuseColor");
+    shape.Material.specularColor = flat.findUniform("material.specularColor");
+    shape.Material.diffuseMap    = flat.findUniform("material.diffuseMap");
+    shape.Material.opacity       = flat.findUniform("material.opacity");
+
+    shape.AmbiantLight = flat.findUniform("AmbiantLight");
+    shape.EyeDirection = flat.findUniform("EyeDirection");
+    for (int i = 0; i < LightSet::Max; ++i) {
+      const char* const*  names = PointLightUniforms[i];
+      DrawablePointLight& light = shape.PointLights[i];
+
+      light.position             = flat.findUniform(names[0]);
+      light.color                = flat.findUniform(names[1]);
+      light.linearAttenuation    = flat.findUniform(names[2]);
+      light.quadraticAttenuation = flat.findUniform(names[3]);
     }
   }
 
+  const FlatShape& OpenGLDataInstance::flatShape(const FlatShapeKey key)
+  {
+    const auto found = flatShapes.find(key);
+    if (found != flatShapes.end()) return *found->second;
+
+    const auto           start  = std::chrono::high_resolution_clock::now();
+    const Program::Stats before = Program::CacheStats;
+    auto                 shape  = std::make_unique<FlatShape>();
+    initializeFlatShape(*shape, key);
+
+    // Built at their first draw, out of the timing of Initialize
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+    flatShapesTime += elapsed.count() / 1000.0f;
+    Logger::info(toString(
+      "[STARTUP] Flat shape variant ", key,
+      (Program::CacheStats.cached > before.cached) ? " from the cache"
+                                                   : " compiled",
+      " in ", elapsed.count() / 1000.0f, "ms, ", flatShapes.size() + 1,
+      " variants in ", flatShapesTime, "ms, programs: ",
+      Program::CacheStats.cached, " from the cache, ",
+      Program::CacheStats.compiled, " compiled"));
+
+    return *flatShapes.emplace(key, std::move(shape)).first->second;
+  }
+
   static inline void initializeTestResources()
   {
     OpenGLDataInstance& instance = OpenGLDataInstance::Instance();
@@ -176,13 +253,24 @@ namespace Soleil {
 		   4, 0, 7,
     };
     // clang-format on
-    glBindBuffer(GL_ARRAY_BUFFER, *instance.box.buffer);
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, *instance.box.buffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *instance.box.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * box.indices.size(),
+                 box.indices.data(), GL_STATIC_DRAW);
+    if (*box.vertexArray) {
+      gl::GlBindVertexArray(*box.vertexArray);
+      gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                             *instance.box.indexBuffer);
+      SetBoxVertexAttributes();
+      gl::GlBindVertexArray(0);
+    }
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     program.attachShader(Shader(GL_VERTEX_SHADER, "box.vert"));
     program.attachShader(Shader(GL_FRAGMENT_SHADER, "box.frag"));
 
-    glBindAttribLocation(program.program, 0, "positionAttribute");
+    program.bindAttribLocation(0, "positionAttribute");
 
     program.compile();
 
@@ -197,18 +285,6 @@ namespace Soleil {
     OpenGLDataInstance& instance = OpenGLDataInstance::Instance();
     Program&            drawable = instance.textProgram;
 
-    drawable.attachShader(Shader(GL_VERTEX_SHADER, "text.vert"));
-    drawable.attachShader(Shader(GL_FRAGMENT_SHADER, "text.frag"));
-
-    glBindAttribLocation(drawable.program, 0, "positionAttribute");
-    glBindAttribLocation(drawable.program, 1, "uvAttribute");
-
-    drawable.compile();
-
-    instance.textModelMatrix = drawable.getUniform("ModelMatrix");
-    instance.textTexture     = drawable.getUniform("FontAtlas");
-    instance.textColor       = drawable.getUniform("Color");
-
 #if 0
     const GLuint chessBoard[] = {
       0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000,
@@ -241,9 +317,44 @@ namespace Soleil {
     const char* font = "juju.ttf";
 #endif
     instance.textAtlas =
-      Text::InitializeAtlasMap(L"ABCDEFGHIJKLMNOPQRSTUVWXYZÀ0123456789abcdefghi"
-                               L"jklmnopqrstuvwxyz +-!.():=\",'/",
-                               font, *instance.textDefaultFontAtlas);
+      Text::InitializeAtlasMap(GameCharMap, font,
+                               *instance.textDefaultFontAtlas);
+
+    std::vector<std::string> defines;
+    if (instance.textAtlas.distanceRange > 0.0f)
+      defines.push_back("DISTANCE_FIELD");
+    drawable.attachShader(Shader(GL_VERTEX_SHADER, "text.vert"));
+    drawable.attachShader(Shader(GL_FRAGMENT_SHADER, "text.frag", defines));
+
+    drawable.bindAttribLocation(0, "positionAttribute");
+    drawable.bindAttribLocation(1, "uvAttribute");
+
+    drawable.compile();
+
+    instance.textModelMatrix = drawable.getUniform("ModelMatrix");
+    instance.textTexture     = drawable.getUniform("FontAtlas");
+    instance.textColor       = drawable.getUniform("Color");
+    instance.textSmoothing   = drawable.findUniform("Smoothing");
+
+    // The quads of the texts follow each other in the stream, four vertices
+    // each
+    std::vector<GLushort> quadElements;
+    quadElements.reserve(TextStream::MaxQuads * 6);
+    for (GLushort first = 0; first < TextStream::MaxQuads * 4; first += 4) {
+      for (const GLushort corner : {0, 1, 2, 2, 3, 0})
+        quadElements.push_back(first + corner);
+    }
+
+    TextStream& stream = instance.textStream;
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *stream.quadElements);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(GLushort) * quadElements.size(), quadElements.data(),
+                 GL_STATIC_DRAW);
+    gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    gl::State().bindBuffer(GL_ARRAY_BUFFER, *stream.vertices);
+    glBufferData(GL_ARRAY_BUFFER, TextStream::Size, nullptr, GL_STREAM_DRAW);
+    throwOnGlError();
   }
 
   static inline void initializePad(void)
@@ -271,6 +382,12 @@ namespace Soleil {
       // clang-format on
 
       glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+      if (*instance.imageVertexArray) {
+        gl::GlBindVertexArray(*instance.imageVertexArray);
+        SetImageVertexAttributes();
+        gl::GlBindVertexArray(0);
+      }
     }
 
     // Also initialize the Image Program
@@ -301,14 +418,41 @@ namespace Soleil {
     throwOnGlError();
   }
 
+  void SetImageVertexAttributes(void)
+  {
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2,
+                          (const GLvoid*)0);
+    glEnableVertexAttribArray(0);
+  }
+
+  void SetBoxVertexAttributes(void)
+  {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3,
+                          (const GLvoid*)0);
+    glEnableVertexAttribArray(0);
+  }
+
   void OpenGLDataInstance::Initialize(void)
   {
+    const auto start = std::chrono::high_resolution_clock::now();
+    Program::CacheStats = Program::Stats();
+
+    // Before the members, so their vertex arrays are created
+    gl::LoadExtensions();
     OpenGLDataInstance::instance = std::make_unique<OpenGLDataInstance>();
     initializeDrawable();
-    initializeFlatShape();
     initializeTestResources();
     initializeText();
     initializePad();
+
+    // Compare a first launch with the next ones to see what the binary cache
+    // saves
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+    Logger::info(toString("[STARTUP] GL resources initialized in ",
+                          elapsed.count() / 1000.0f, "ms, programs: ",
+                          Program::CacheStats.cached, " from the cache, ",
+                          Program::CacheStats.compiled, " compiled"));
   }
 
 } // Soleil
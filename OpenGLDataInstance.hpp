@@ -22,16 +22,21 @@
 #ifndef SOLEIL__OPENGLDATAINSTANCE_HPP_
 #define SOLEIL__OPENGLDATAINSTANCE_HPP_
 
+#include "Culling.hpp"
 #include "OpenGLInclude.hpp"
 #include "Program.hpp"
 #include "Shader.hpp"
 #include "Text.hpp"
+#include "TextureCache.hpp"
 
 #include <cassert>
+#include <cstdint>
+#include <map>
 #include <memory>
 
 namespace Soleil {
 
+  // Lights of the Phong program. The flat shapes take LightSet::Max lights.
   static constexpr int DefinedMaxLights = 16;
 
   struct DrawablePointLight
@@ -50,6 +55,7 @@ namespace Soleil {
     GLint diffuseColor;
     GLint specularColor;
     GLint diffuseMap;
+    GLint opacity; // Only in the ALPHA_BLEND flat shapes
   };
 
   struct FlatShape
@@ -58,15 +64,31 @@ namespace Soleil {
     GLint   MVPMatrix;
     GLint   MVMatrix;
     GLint   NormalMatrix;
+    GLint   VPMatrix; // Instanced variant only, the others are then unused
     GLint   AmbiantLight;
     GLint   EyeDirection;
     GLint   ConstantAttenuation;
-    GLint   NumberOfLights;
 
     DrawableMaterial   Material;
-    DrawablePointLight PointLights[DefinedMaxLights];
+    DrawablePointLight PointLights[LightSet::Max]; // LIGHT_COUNT are used
   };
 
+  /**
+   * Identify a variant of the flat shape program: the MaterialFeature flags
+   * of the material, whether the model matrices are instance attributes and
+   * the number of lights.
+   */
+  typedef std::uint32_t FlatShapeKey;
+
+  inline FlatShapeKey MakeFlatShapeKey(const std::uint8_t features,
+                                       const bool         instanced,
+                                       const int          lightCount) noexcept
+  {
+    assert(lightCount >= 0 && lightCount <= LightSet::Max);
+
+    return features | (instanced << 8) | (lightCount << 16);
+  }
+
   struct BoundingBoxShape
   {
     Program               program;
@@ -75,9 +97,38 @@ namespace Soleil {
     GLint                 color;
     GLint                 VPMatrix;
     gl::Buffer            buffer;
+    gl::Buffer            indexBuffer;
+    gl::VertexArray       vertexArray;
     std::vector<GLushort> indices;
   };
 
+  /**
+   * Vertex buffer shared by the texts, filled as a ring: each text is
+   * streamed after the previous ones with glBufferSubData and the buffer is
+   * orphaned once full. The quads of all the texts are drawn with the same
+   * static elements.
+   */
+  struct TextStream
+  {
+    enum : GLsizeiptr
+    {
+      Size     = 64 * 1024, // Bytes
+      MaxQuads = Size / (4 * sizeof(CharVertex))
+    };
+
+    gl::Buffer vertices;
+    gl::Buffer quadElements; // Of MaxQuads quads
+    GLintptr   head       = 0;
+    unsigned   generation = 1; // Incremented at each orphaning
+  };
+
+  /**
+   * Point the attributes of the image and box programs to the vertices of
+   * the bound GL_ARRAY_BUFFER (imageBuffer and box.buffer).
+   */
+  void SetImageVertexAttributes(void);
+  void SetBoxVertexAttributes(void);
+
   struct OpenGLDataInstance
   {
     // TODO: Create a struct for the Drawable Shader
@@ -91,17 +142,23 @@ namespace Soleil {
     GLint drawableConstantAttenuation;
     GLint drawableNumberOfLights;
 
-    FlatShape flat;
+    // Variants of the flat shape program, compiled on their first use, and
+    // the milliseconds spent building them. The instanced ones require
+    // gl::Extensions::instancedArrays
+    std::map<FlatShapeKey, std::unique_ptr<FlatShape>> flatShapes;
+    float                                              flatShapesTime = 0.0f;
+    gl::Buffer                                         instanceBuffer;
 
     DrawableMaterial   drawableMaterial;
     DrawablePointLight drawablePointLights[DefinedMaxLights];
 
     // 2D Image
-    gl::Buffer imageBuffer;
-    Program    imageProgram;
-    GLint      imageModelMatrix;
-    GLint      imageColor;
-    GLint      imageImage;
+    gl::Buffer      imageBuffer;
+    gl::VertexArray imageVertexArray;
+    Program         imageProgram;
+    GLint           imageModelMatrix;
+    GLint           imageColor;
+    GLint           imageImage;
 
     // Text
     Program         textProgram;
@@ -110,12 +167,15 @@ namespace Soleil {
     GLint           textTexture;
     GLint           textColor;
     GLint           textModelMatrix;
+    GLint           textSmoothing; // Only with a distance field atlas
+    TextStream        textStream;
+    Text::LayoutCache textLayouts;
 
     // Textures
-    gl::Texture              textureTest;
-    gl::Texture              textureBlack;
-    gl::Texture              texturePad;
-    std::vector<gl::Texture> textures; // TODO: Do not let the container extend.
+    gl::Texture  textureTest;
+    gl::Texture  textureBlack;
+    gl::Texture  texturePad;
+    TextureCache textures; // Of the models, shared by their materials
 
     BoundingBoxShape box;
 
@@ -132,11 +192,12 @@ namespace Soleil {
 
     static void Initialize(void);
 
-    OpenGLDataInstance()
-      : textures(0)
-    {
-      textures.reserve(32); // TODO: Fix this number
-    };
+    /**
+     * Return the variant of the flat shape program, compiling it if needed.
+     */
+    const FlatShape& flatShape(const FlatShapeKey key);
+
+    OpenGLDataInstance() {}
     OpenGLDataInstance(const OpenGLDataInstance&) = delete;
 
   public:
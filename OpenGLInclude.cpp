@@ -20,10 +20,38 @@
  */
 
 #include "OpenGLInclude.hpp"
+#include "StateCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 namespace Soleil {
   namespace gl {
 
+    struct ObjectIndices
+    {
+      std::vector<std::uint32_t> released; // To reuse
+      std::uint32_t              next = 1;
+    };
+
+    static ObjectIndices objectIndices[(int)ObjectKind::Kinds];
+
+    std::uint32_t AcquireObjectIndex(ObjectKind kind)
+    {
+      ObjectIndices& objects = objectIndices[(int)kind];
+      if (objects.released.empty()) return objects.next++;
+
+      const std::uint32_t index = objects.released.back();
+      objects.released.pop_back();
+      return index;
+    }
+
+    void ReleaseObjectIndex(ObjectKind kind, std::uint32_t index) noexcept
+    {
+      objectIndices[(int)kind].released.push_back(index);
+    }
+
     void GlGenFramebuffers(GLsizei i, GLuint* names)
     {
       glGenFramebuffers(i, names);
@@ -49,6 +77,7 @@ namespace Soleil {
     void GlDeleteTextures(GLsizei i, const GLuint* names)
     {
       glDeleteTextures(i, names);
+      for (GLsizei n = 0; n < i; ++n) State().forgetTexture(names[n]);
     }
 
     void GlBindFramebuffer(GLenum target, GLuint name)
@@ -63,12 +92,12 @@ namespace Soleil {
 
     void GlBindTexture(GLenum target, GLuint name)
     {
-      glBindTexture(target, name);
+      State().bindTexture(target, name);
     }
 
     void GlBindBuffer(GLenum target, GLuint name)
     {
-      glBindBuffer(target, name);
+      State().bindBuffer(target, name);
     }
 
     void GlGenBuffers(GLsizei i, GLuint* names) { glGenBuffers(i, names); }
@@ -76,6 +105,270 @@ namespace Soleil {
     void GlDeleteBuffers(GLsizei i, const GLuint* names)
     {
       glDeleteBuffers(i, names);
+      for (GLsizei n = 0; n < i; ++n) State().forgetBuffer(names[n]);
+    }
+
+    static Extensions extensions;
+
+    void GlGenVertexArrays(GLsizei i, GLuint* names)
+    {
+      if (extensions.vertexArrayObject)
+        extensions.genVertexArrays(i, names);
+      else
+        std::fill(names, names + i, 0);
+    }
+
+    void GlDeleteVertexArrays(GLsizei i, const GLuint* names)
+    {
+      if (extensions.vertexArrayObject == false) return;
+
+      extensions.deleteVertexArrays(i, names);
+      for (GLsizei n = 0; n < i; ++n) State().forgetVertexArray(names[n]);
+    }
+
+    void GlBindVertexArray(GLuint name) { State().bindVertexArray(name); }
+
+    static void* GetProcAddress(const char* name)
+    {
+#if defined(SOLEIL_FORCE_ES) || defined(__ANDROID__)
+      return reinterpret_cast<void*>(eglGetProcAddress(name));
+#else
+      return reinterpret_cast<void*>(glfwGetProcAddress(name));
+#endif
+    }
+
+    bool HasExtension(const char* name)
+    {
+      const char* all =
+        reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+      if (all == nullptr) return false;
+
+      const std::size_t length = std::strlen(name);
+      for (const char* found = std::strstr(all, name); found != nullptr;
+           found             = std::strstr(found + length, name)) {
+        // Whole names only, GL_EXT_foo is not GL_EXT_foo_bar
+        const bool start = (found == all || found[-1] == ' ');
+        const bool end   = (found[length] == ' ' || found[length] == '\0');
+        if (start && end) return true;
+      }
+      return false;
+    }
+
+    void LoadExtensions(void)
+    {
+      extensions = Extensions();
+
+      const char* version =
+        reinterpret_cast<const char*>(glGetString(GL_VERSION));
+      const bool es3 =
+        version != nullptr && std::strncmp(version, "OpenGL ES 3", 11) == 0;
+      // Desktop versions start with the number, "3.0 Mesa ..."
+      const bool gl3 = version != nullptr && version[0] >= '3' &&
+                       version[0] <= '9' && version[1] == '.';
+
+      const struct
+      {
+        const char* extension; // nullptr when core in GLES 3
+        const char* drawElementsInstanced;
+        const char* vertexAttribDivisor;
+      } instancedArrays[] = {
+        {nullptr, "glDrawElementsInstanced", "glVertexAttribDivisor"},
+        {"GL_ANGLE_instanced_arrays", "glDrawElementsInstancedANGLE",
+         "glVertexAttribDivisorANGLE"},
+        {"GL_EXT_instanced_arrays", "glDrawElementsInstancedEXT",
+         "glVertexAttribDivisorEXT"},
+        {"GL_NV_instanced_arrays", "glDrawElementsInstancedNV",
+         "glVertexAttribDivisorNV"},
+      };
+
+      for (const auto& candidate : instancedArrays) {
+        if (candidate.extension ? !HasExtension(candidate.extension) : !es3)
+          continue;
+
+        extensions.drawElementsInstanced = reinterpret_cast<
+          DrawElementsInstancedProc>(
+          GetProcAddress(candidate.drawElementsInstanced));
+        extensions.vertexAttribDivisor = reinterpret_cast<
+          VertexAttribDivisorProc>(
+          GetProcAddress(candidate.vertexAttribDivisor));
+        if (extensions.drawElementsInstanced && extensions.vertexAttribDivisor) {
+          extensions.instancedArrays = true;
+          SOLEIL__LOGGER_DEBUG(toString("Instancing with ",
+                                        candidate.drawElementsInstanced));
+          break;
+        }
+      }
+      if (extensions.instancedArrays == false) {
+        extensions.drawElementsInstanced = nullptr;
+        extensions.vertexAttribDivisor   = nullptr;
+        SOLEIL__LOGGER_DEBUG("No instancing, falling back to a draw per shape");
+      }
+
+      const struct
+      {
+        const char* extension; // nullptr when core
+        const char* gen;
+        const char* del;
+        const char* bind;
+      } vertexArrays[] = {
+        {nullptr, "glGenVertexArrays", "glDeleteVertexArrays",
+         "glBindVertexArray"},
+        {"GL_OES_vertex_array_object", "glGenVertexArraysOES",
+         "glDeleteVertexArraysOES", "glBindVertexArrayOES"},
+      };
+
+      for (const auto& candidate : vertexArrays) {
+        if (candidate.extension ? !HasExtension(candidate.extension)
+                                : !(es3 || gl3))
+          continue;
+
+        extensions.genVertexArrays =
+          reinterpret_cast<GenVertexArraysProc>(GetProcAddress(candidate.gen));
+        extensions.deleteVertexArrays = reinterpret_cast<
+          DeleteVertexArraysProc>(GetProcAddress(candidate.del));
+        extensions.bindVertexArray =
+          reinterpret_cast<BindVertexArrayProc>(GetProcAddress(candidate.bind));
+        if (extensions.genVertexArrays && extensions.deleteVertexArrays &&
+            extensions.bindVertexArray) {
+          extensions.vertexArrayObject = true;
+          SOLEIL__LOGGER_DEBUG(toString("Vertex arrays with ", candidate.gen));
+          break;
+        }
+      }
+      if (extensions.vertexArrayObject == false) {
+        extensions.genVertexArrays    = nullptr;
+        extensions.deleteVertexArrays = nullptr;
+        extensions.bindVertexArray    = nullptr;
+        SOLEIL__LOGGER_DEBUG("No vertex array object, attributes set per draw");
+      }
+
+      // Desktop versions from 4.1 have the program binaries in their core
+      const bool gl41 = gl3 && (version[0] > '4' ||
+                                (version[0] == '4' && version[2] >= '1'));
+      const struct
+      {
+        const char* extension; // nullptr when core
+        const char* get;
+        const char* load;
+        const char* parameter; // nullptr when the hint does not exist
+      } programBinaries[] = {
+        {nullptr, "glGetProgramBinary", "glProgramBinary",
+         "glProgramParameteri"},
+        {"GL_OES_get_program_binary", "glGetProgramBinaryOES",
+         "glProgramBinaryOES", nullptr},
+        {"GL_ARB_get_program_binary", "glGetProgramBinary", "glProgramBinary",
+         "glProgramParameteri"},
+      };
+
+      for (const auto& candidate : programBinaries) {
+        if (candidate.extension ? !HasExtension(candidate.extension)
+                                : !(es3 || gl41))
+          continue;
+
+        // Drivers may have the extension without any format to save in
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+        if (formats < 1) break;
+
+        extensions.getProgramBinary =
+          reinterpret_cast<GetProgramBinaryProc>(GetProcAddress(candidate.get));
+        extensions.programBinary =
+          reinterpret_cast<ProgramBinaryProc>(GetProcAddress(candidate.load));
+        if (candidate.parameter) {
+          extensions.programParameteri =
+            reinterpret_cast<ProgramParameteriProc>(
+              GetProcAddress(candidate.parameter));
+        }
+        if (extensions.getProgramBinary && extensions.programBinary) {
+          extensions.programBinaries = true;
+          SOLEIL__LOGGER_DEBUG(toString("Program binaries with ",
+                                        candidate.load));
+          break;
+        }
+      }
+      if (extensions.programBinaries == false) {
+        extensions.getProgramBinary  = nullptr;
+        extensions.programBinary     = nullptr;
+        extensions.programParameteri = nullptr;
+        SOLEIL__LOGGER_DEBUG("No program binary, programs built from source");
+      }
+
+      // The ES entry points have the suffix, the desktop ones do not
+      if (HasExtension("GL_KHR_debug")) {
+        for (const char* name :
+             {"glDebugMessageCallbackKHR", "glDebugMessageCallback"}) {
+          extensions.debugMessageCallback =
+            reinterpret_cast<DebugMessageCallbackProc>(GetProcAddress(name));
+          if (extensions.debugMessageCallback) {
+            extensions.debugOutput = true;
+            SOLEIL__LOGGER_DEBUG(toString("Driver messages with ", name));
+            break;
+          }
+        }
+      }
+
+      const bool gl43 = gl3 && (version[0] > '4' ||
+                                (version[0] == '4' && version[2] >= '3'));
+      if (HasExtension("GL_OES_compressed_ETC1_RGB8_texture"))
+        extensions.etc1Format = GL_ETC1_RGB8_OES;
+      else if (es3 || gl43 || HasExtension("GL_ARB_ES3_compatibility"))
+        extensions.etc1Format = GL_COMPRESSED_RGB8_ETC2;
+      SOLEIL__LOGGER_DEBUG(extensions.etc1Format
+                             ? "ETC1 textures loaded compressed"
+                             : "No ETC1 texture, images loaded from PNG");
+
+      // The driver messages follow the error checks
+      SetErrorCheck(GetErrorCheck());
+    }
+
+    const Extensions& GetExtensions(void) noexcept { return extensions; }
+
+    namespace detail {
+#ifdef NDEBUG
+      ErrorCheck errorCheck = ErrorCheck::Off;
+#else
+      ErrorCheck errorCheck = ErrorCheck::PerFrame;
+#endif
+    } // detail
+
+    static void GL_APIENTRY DebugMessage(GLenum /*source*/, GLenum type,
+                                         GLuint id, GLenum severity,
+                                         GLsizei length, const GLchar* message,
+                                         const void* /*userParam*/)
+    {
+      if (severity == GL_DEBUG_SEVERITY_NOTIFICATION_KHR) return;
+
+      const std::string text =
+        (length < 0) ? std::string(message) : std::string(message, length);
+      if (type == GL_DEBUG_TYPE_ERROR_KHR)
+        Logger::error(toString("[GL] Error ", id, ": ", text));
+      else
+        Logger::warning(toString("[GL] ", id, ": ", text));
+    }
+
+    void SetErrorCheck(const ErrorCheck check)
+    {
+      detail::errorCheck = std::min(check, (ErrorCheck)SOLEIL__GL_ERROR_CHECK);
+      if (extensions.debugOutput == false) return;
+
+      if (detail::errorCheck == ErrorCheck::Off) {
+        glDisable(GL_DEBUG_OUTPUT_KHR);
+        return;
+      }
+
+      glEnable(GL_DEBUG_OUTPUT_KHR);
+      extensions.debugMessageCallback(DebugMessage, nullptr);
+      // Only then is the message emitted by the faulty call itself
+      if (detail::errorCheck == ErrorCheck::PerCall)
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
+      else
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
+    }
+
+    void CheckFrameErrors(const char* file, int line)
+    {
+      if (detail::errorCheck != ErrorCheck::Off)
+        _checkGLError(true, file, line);
     }
 
   } // gl
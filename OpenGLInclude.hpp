@@ -35,6 +35,10 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#ifndef GL_APIENTRY
+#define GL_APIENTRY GLAPIENTRY
+#endif
+
 #else
 
 #include <GL/glew.h>
@@ -44,11 +48,70 @@
 
 #endif
 
+// Same values for the OES extension and the core profiles
+#ifndef GL_PROGRAM_BINARY_LENGTH_OES
+#define GL_PROGRAM_BINARY_LENGTH_OES 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS_OES
+#define GL_NUM_PROGRAM_BINARY_FORMATS_OES 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_DEBUG_OUTPUT_KHR
+#define GL_DEBUG_OUTPUT_KHR 0x92E0
+#endif
+#ifndef GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR 0x8242
+#endif
+#ifndef GL_DEBUG_TYPE_ERROR_KHR
+#define GL_DEBUG_TYPE_ERROR_KHR 0x824C
+#endif
+#ifndef GL_DEBUG_SEVERITY_NOTIFICATION_KHR
+#define GL_DEBUG_SEVERITY_NOTIFICATION_KHR 0x826B
+#endif
+// Compressed textures, ETC2 is core in GLES 3 and GL 4.3
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
 #include "Logger.hpp"
 #include "stringutils.hpp"
 
-#define throwOnGlError() ::Soleil::_checkGLError(true, __FILE__, __LINE__)
-#define warnOnGlError() ::Soleil::_checkGLError(false, __FILE__, __LINE__)
+#include <cstdint>
+
+// Highest tier of GL error checks built in, see gl::ErrorCheck: 0 for none,
+// 1 for once per frame, 2 to also check after the calls. Release builds
+// cannot check after each call.
+#ifndef SOLEIL__GL_ERROR_CHECK
+#ifdef NDEBUG
+#define SOLEIL__GL_ERROR_CHECK 1
+#else
+#define SOLEIL__GL_ERROR_CHECK 2
+#endif
+#endif
+
+#if SOLEIL__GL_ERROR_CHECK >= 2
+#define SOLEIL__CHECK_GL_CALL(throwOnError)                                    \
+  ((::Soleil::gl::GetErrorCheck() == ::Soleil::gl::ErrorCheck::PerCall)        \
+     ? ::Soleil::_checkGLError(throwOnError, __FILE__, __LINE__)               \
+     : (void)0)
+#else
+#define SOLEIL__CHECK_GL_CALL(throwOnError) ((void)0)
+#endif
+
+#define throwOnGlError() SOLEIL__CHECK_GL_CALL(true)
+#define warnOnGlError() SOLEIL__CHECK_GL_CALL(false)
+
+#if SOLEIL__GL_ERROR_CHECK >= 1
+#define throwOnFrameGlError()                                                  \
+  ::Soleil::gl::CheckFrameErrors(__FILE__, __LINE__)
+#else
+#define throwOnFrameGlError() ((void)0)
+#endif
 
 namespace Soleil {
 
@@ -89,6 +152,42 @@ namespace Soleil {
       throw std::runtime_error("GL Error occured (see logs).");
   }
 
+  namespace gl {
+
+    /**
+     * When the GL errors are looked for. Each glGetError may stall the
+     * pipeline, the frames of a release build do not call it at all.
+     */
+    enum class ErrorCheck
+    {
+      Off,
+      PerFrame, // Once at the end of each frame, see throwOnFrameGlError
+      PerCall,  // Also after the calls, see throwOnGlError
+    };
+
+    namespace detail {
+      extern ErrorCheck errorCheck;
+    } // detail
+
+    inline ErrorCheck GetErrorCheck(void) noexcept
+    {
+      return detail::errorCheck;
+    }
+
+    /**
+     * Limited to the tier built in (SOLEIL__GL_ERROR_CHECK). Debug builds
+     * default to PerFrame and release builds to Off. With KHR_debug, the
+     * driver messages are also logged as soon as they are emitted.
+     */
+    void SetErrorCheck(const ErrorCheck check);
+
+    /**
+     * Look for the errors of the whole frame, if the tier is not Off.
+     */
+    void CheckFrameErrors(const char* file, int line);
+
+  } // gl
+
   // Below are RAII Wrapper for OpenGL -----------------------------------------
 
   namespace gl {
@@ -97,26 +196,51 @@ namespace Soleil {
     void GlGenRenderbuffers(GLsizei i, GLuint* names);
     void GlGenTextures(GLsizei i, GLuint* names);
     void GlGenBuffers(GLsizei i, GLuint* names);
+    void GlGenVertexArrays(GLsizei i, GLuint* names);
 
     void GlDeleteFramebuffers(GLsizei i, const GLuint* names);
     void GlDeleteRenderbuffers(GLsizei i, const GLuint* names);
     void GlDeleteTextures(GLsizei i, const GLuint* names);
     void GlDeleteBuffers(GLsizei i, const GLuint* names);
+    void GlDeleteVertexArrays(GLsizei i, const GLuint* names);
 
     void GlBindFramebuffer(GLenum target, GLuint name);
     void GlBindRenderbuffer(GLenum target, GLuint name);
+    // Texture, buffer and vertex array bindings go through the StateCache
     void GlBindTexture(GLenum target, GLuint name);
     void GlBindBuffer(GLenum target, GLuint name);
+    void GlBindVertexArray(GLuint name);
+
+    enum class ObjectKind
+    {
+      Program,
+      Buffer,
+      Texture,
+      Kinds,
+      None = Kinds // Not indexed
+    };
+
+    /**
+     * Small dense index of the programs, buffers and textures, taken when
+     * they are created and reused once they are deleted. The driver names
+     * are neither small nor dense, the RenderQueue keys pack these instead.
+     * Indices start at 1, 0 is left for no object.
+     */
+    std::uint32_t AcquireObjectIndex(ObjectKind kind);
+    void ReleaseObjectIndex(ObjectKind kind, std::uint32_t index) noexcept;
 
     template <void GenFunction(GLsizei, GLuint*),
-              void DeleteFunction(GLsizei, const GLuint*)>
+              void DeleteFunction(GLsizei, const GLuint*),
+              ObjectKind kind = ObjectKind::None>
     class Generator
     {
     public:
       Generator()
-        : toClean(true)
+        : objectIndex(0)
+        , toClean(true)
       {
         GenFunction(1, &name);
+        if (kind != ObjectKind::None) objectIndex = AcquireObjectIndex(kind);
         throwOnGlError();
       }
 
@@ -125,23 +249,31 @@ namespace Soleil {
         if (toClean) {
           SOLEIL__LOGGER_DEBUG(toString("~GL Resource destructed"));
           DeleteFunction(1, &name);
+          if (kind != ObjectKind::None) ReleaseObjectIndex(kind, objectIndex);
         }
       }
 
       GLuint operator*(void)const { return name; }
 
+      /**
+       * See AcquireObjectIndex, 0 if the kind is not indexed
+       */
+      std::uint32_t index(void) const noexcept { return objectIndex; }
+
       Generator(const Generator&) = delete;
       Generator& operator=(const Generator&) = delete;
 
       Generator(Generator&& other)
         : name(other.name)
+        , objectIndex(other.objectIndex)
       {
         other.toClean = false;
       }
 
     private:
-      GLuint name;
-      bool   toClean;
+      GLuint        name;
+      std::uint32_t objectIndex;
+      bool          toClean;
     };
 
     template <void BindFunction(GLenum, GLuint), GLuint defValue>
@@ -160,10 +292,88 @@ namespace Soleil {
       GLenum target;
     };
 
-    typedef Generator<GlGenTextures, GlDeleteTextures>           Texture;
+    typedef void(GL_APIENTRY* DrawElementsInstancedProc)(GLenum mode,
+                                                         GLsizei      count,
+                                                         GLenum       type,
+                                                         const void*  indices,
+                                                         GLsizei primcount);
+    typedef void(GL_APIENTRY* VertexAttribDivisorProc)(GLuint index,
+                                                       GLuint divisor);
+    typedef void(GL_APIENTRY* GenVertexArraysProc)(GLsizei n, GLuint* arrays);
+    typedef void(GL_APIENTRY* DeleteVertexArraysProc)(GLsizei       n,
+                                                      const GLuint* arrays);
+    typedef void(GL_APIENTRY* BindVertexArrayProc)(GLuint array);
+    typedef void(GL_APIENTRY* GetProgramBinaryProc)(GLuint   program,
+                                                    GLsizei  bufSize,
+                                                    GLsizei* length,
+                                                    GLenum*  binaryFormat,
+                                                    void*    binary);
+    typedef void(GL_APIENTRY* ProgramBinaryProc)(GLuint      program,
+                                                 GLenum      binaryFormat,
+                                                 const void* binary,
+                                                 GLint       length);
+    typedef void(GL_APIENTRY* ProgramParameteriProc)(GLuint program,
+                                                     GLenum pname,
+                                                     GLint  value);
+    typedef void(GL_APIENTRY* DebugProc)(GLenum source, GLenum type,
+                                         GLuint id, GLenum severity,
+                                         GLsizei       length,
+                                         const GLchar* message,
+                                         const void*   userParam);
+    typedef void(GL_APIENTRY* DebugMessageCallbackProc)(DebugProc   callback,
+                                                        const void* userParam);
+
+    /**
+     * Optional features of the current context, see LoadExtensions.
+     */
+    struct Extensions
+    {
+      // Per instance attributes (ANGLE, EXT or NV extension, core in GLES 3)
+      bool                      instancedArrays       = false;
+      DrawElementsInstancedProc drawElementsInstanced = nullptr;
+      VertexAttribDivisorProc   vertexAttribDivisor   = nullptr;
+
+      // Vertex array objects (OES extension, core in GLES 3 and GL 3)
+      bool                   vertexArrayObject  = false;
+      GenVertexArraysProc    genVertexArrays    = nullptr;
+      DeleteVertexArraysProc deleteVertexArrays = nullptr;
+      BindVertexArrayProc    bindVertexArray    = nullptr;
+
+      // Linked programs saved and reloaded (OES extension, core in GLES 3 and
+      // GL 4.1). Only set if the driver has at least one binary format. The
+      // binaries are asked for with programParameteri, missing from the OES
+      // extension.
+      bool                  programBinaries   = false;
+      GetProgramBinaryProc  getProgramBinary  = nullptr;
+      ProgramBinaryProc     programBinary     = nullptr;
+      ProgramParameteriProc programParameteri = nullptr;
+
+      // Messages of the driver (KHR_debug)
+      bool                     debugOutput          = false;
+      DebugMessageCallbackProc debugMessageCallback = nullptr;
+
+      // Internal format the ETC1 textures are uploaded as, 0 if unsupported:
+      // the OES extension, or ETC2 (a superset) in GLES 3 and GL 4.3
+      GLenum etc1Format = 0;
+    };
+
+    /**
+     * Query the features of the current context. Has to be called once the
+     * context is current and before any call to GetExtensions.
+     */
+    void              LoadExtensions(void);
+    const Extensions& GetExtensions(void) noexcept;
+    bool              HasExtension(const char* name);
+
+    typedef Generator<GlGenTextures, GlDeleteTextures, ObjectKind::Texture>
+      Texture;
     typedef Generator<GlGenFramebuffers, GlDeleteFramebuffers>   FrameBuffer;
     typedef Generator<GlGenRenderbuffers, GlDeleteRenderbuffers> RenderBuffer;
-    typedef Generator<GlGenBuffers, GlDeleteBuffers>             Buffer;
+    typedef Generator<GlGenBuffers, GlDeleteBuffers, ObjectKind::Buffer>
+      Buffer;
+    // Named 0 when vertex array objects are not available: the attributes
+    // have then to be set before each draw.
+    typedef Generator<GlGenVertexArrays, GlDeleteVertexArrays> VertexArray;
     typedef BindGuard<GlBindFramebuffer, 0>  BindFrameBuffer;
     typedef BindGuard<GlBindRenderbuffer, 0> BindRenderBuffer;
     typedef BindGuard<GlBindTexture, 0>      BindTexture;
@@ -21,23 +21,124 @@
 
 #include "Program.hpp"
 #include "Logger.hpp"
+#include "StateCache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
 
 namespace Soleil {
 
+  std::string    Program::BinaryCacheDirectory;
+  Program::Stats Program::CacheStats;
+
+  /**
+   * Header of a cached binary, followed by the binary itself
+   */
+  struct ProgramBinaryHeader
+  {
+    std::uint32_t magic;
+    std::uint32_t format;  // As given by the driver
+    std::uint64_t sources; // Hash of the shaders
+    std::uint64_t driver;  // Hash of the driver identity
+    std::uint32_t length;  // Of the binary, in bytes
+  };
+
+  static constexpr std::uint32_t ProgramBinaryMagic = 0x50425231; // PBR1
+
+  // 64 bits FNV-1a, continued from hash
+  static std::uint64_t HashBytes(const char* bytes, const std::size_t length,
+                                 std::uint64_t hash = 14695981039346656037ull)
+  {
+    for (std::size_t i = 0; i < length; ++i) {
+      hash ^= static_cast<unsigned char>(bytes[i]);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  /**
+   * The binaries are only valid for the driver that built them
+   */
+  static std::uint64_t HashDriver(void)
+  {
+    std::uint64_t hash = HashBytes(nullptr, 0);
+
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      const char* value = reinterpret_cast<const char*>(glGetString(name));
+      if (value) hash = HashBytes(value, std::strlen(value) + 1, hash);
+    }
+    return hash;
+  }
+
+  static std::string BinaryFileName(const std::uint64_t sources)
+  {
+    std::ostringstream name;
+
+    name << Program::BinaryCacheDirectory << std::hex << sources << ".bin";
+    return name.str();
+  }
+
   Program::Program()
     : program(glCreateProgram())
+    , index(gl::AcquireObjectIndex(gl::ObjectKind::Program))
   {
   }
 
-  Program::~Program() { glDeleteProgram(program); }
+  Program::~Program()
+  {
+    glDeleteProgram(program);
+    gl::State().forgetProgram(program);
+    gl::ReleaseObjectIndex(gl::ObjectKind::Program, index);
+  }
 
   void Program::attachShader(const Shader& shader)
   {
-    glAttachShader(program, *shader);
+    shaders.push_back(shader);
+  }
+
+  void Program::bindAttribLocation(const GLuint index, const GLchar* name)
+  {
+    glBindAttribLocation(program, index, name);
+    attributes.emplace_back(index, name);
   }
 
   void Program::compile(void)
   {
+    const bool cache = BinaryCacheDirectory.empty() == false &&
+                       gl::GetExtensions().programBinaries;
+    std::uint64_t sources = HashBytes(nullptr, 0);
+    std::uint64_t driver  = 0;
+
+    if (cache) {
+      for (const auto& shader : shaders) {
+        const std::string& source = shader.getSource();
+        sources = HashBytes(source.data(), source.size() + 1, sources);
+      }
+      // Linked in the binary
+      for (const auto& attribute : attributes) {
+        const std::string binding =
+          toString(attribute.first, ":", attribute.second);
+        sources = HashBytes(binding.data(), binding.size() + 1, sources);
+      }
+      driver = HashDriver();
+
+      if (loadBinary(sources, driver)) {
+        shaders.clear();
+        reflectUniforms();
+        CacheStats.cached++;
+        throwOnGlError();
+        return;
+      }
+    }
+
+    for (const auto& shader : shaders) glAttachShader(program, *shader);
+    // Otherwise GLES 3 and GL drivers may not keep a binary to save
+    if (cache && gl::GetExtensions().programParameteri) {
+      gl::GetExtensions().programParameteri(
+        program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
 
     GLint infoLen    = 0;
@@ -65,15 +166,122 @@ namespace Soleil {
       Logger::info(fin);
     }
 
+    shaders.clear();
+    reflectUniforms();
+    CacheStats.compiled++;
+    if (cache) saveBinary(sources, driver);
+    throwOnGlError();
+  }
+
+  bool Program::loadBinary(const std::uint64_t sources,
+                           const std::uint64_t driver)
+  {
+    std::ifstream in(BinaryFileName(sources), std::ios::binary);
+    if (!in) return false;
+
+    ProgramBinaryHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != ProgramBinaryMagic || header.sources != sources)
+      return false;
+
+    if (header.driver != driver) {
+      SOLEIL__LOGGER_DEBUG("Program binary built by another driver, ignored");
+      return false;
+    }
+
+    std::vector<char> binary(header.length);
+    if (!in.read(binary.data(), binary.size())) return false;
+
+    gl::GetExtensions().programBinary(program, header.format, binary.data(),
+                                      header.length);
+
+    // The driver may still refuse it, then the sources are compiled again
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    warnOnGlError();
+    if (isLinked == GL_FALSE) {
+      SOLEIL__LOGGER_DEBUG("Program binary refused by the driver");
+      return false;
+    }
+    return true;
+  }
+
+  void Program::saveBinary(const std::uint64_t sources,
+                           const std::uint64_t driver)
+  {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length < 1) return;
+
+    std::vector<char> binary(length);
+    GLenum            format = 0;
+    gl::GetExtensions().getProgramBinary(program, length, &length, &format,
+                                         binary.data());
+    throwOnGlError();
+
+    // Only the last level of the directory is created
+    mkdir(BinaryCacheDirectory.c_str(), 0755);
+
+    const ProgramBinaryHeader header = {ProgramBinaryMagic, format, sources,
+                                        driver, (std::uint32_t)length};
+    std::ofstream out(BinaryFileName(sources), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(binary.data(), length);
+    if (!out)
+      Logger::warning(toString("Cannot save the program binary in ",
+                               BinaryFileName(sources)));
+  }
+
+  void Program::reflectUniforms(void)
+  {
+    GLint count     = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    uniforms.clear();
+    uniforms.reserve(count);
+    std::vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < count; ++i) {
+      GLsizei length = 0;
+      GLint   size   = 0;
+      GLenum  type   = 0;
+      glGetActiveUniform(program, i, name.size(), &length, &size, &type,
+                         name.data());
+
+      const std::string uniform(name.data(), length);
+      const GLint       location =
+        glGetUniformLocation(program, uniform.c_str());
+      uniforms.emplace(uniform, location);
+
+      // Arrays of basic types are listed once as "name[0]"
+      const std::size_t bracket = uniform.rfind("[0]");
+      if (size > 1 && bracket == uniform.size() - 3) {
+        const std::string base = uniform.substr(0, bracket);
+
+        uniforms.emplace(base, location);
+        for (GLint e = 1; e < size; ++e) {
+          const std::string element = toString(base, "[", e, "]");
+          uniforms.emplace(element,
+                           glGetUniformLocation(program, element.c_str()));
+        }
+      }
+    }
     throwOnGlError();
   }
 
   GLint Program::getUniform(const GLchar* name) const
   {
-    GLint location = glGetUniformLocation(program, name);
-    if (location < 0)
+    const auto found = uniforms.find(name);
+    if (found == uniforms.end())
       throw std::runtime_error(toString("Cannot find location: ", name));
-    return location;
+    return found->second;
+  }
+
+  GLint Program::findUniform(const GLchar* name) const noexcept
+  {
+    const auto found = uniforms.find(name);
+    return (found == uniforms.end()) ? -1 : found->second;
   }
 
 } // Soleil
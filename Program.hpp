@@ -25,10 +25,19 @@
 #include "OpenGLInclude.hpp"
 #include "Shader.hpp"
 
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace Soleil {
 
+  /**
+   * A linked GL program. When the context can save program binaries and a
+   * BinaryCacheDirectory is set, the linked program is kept there and
+   * reloaded on the next launches instead of compiling its shaders.
+   */
   class Program
   {
   public:
@@ -36,14 +45,59 @@ namespace Soleil {
     virtual ~Program();
 
   public:
+    /**
+     * The shader is compiled by compile(), only if the program is not in the
+     * cache.
+     */
     void attachShader(const Shader& shader);
+
+    /**
+     * glBindAttribLocation, the binding being part of the key of the cached
+     * binary.
+     */
+    void bindAttribLocation(const GLuint index, const GLchar* name);
     void compile(void);
     
   public:
+    /**
+     * Location of an active uniform, from the table filled by compile. Throw
+     * if the program does not use it.
+     */
     GLint getUniform(const GLchar* name) const;
 
+    /**
+     * Same as getUniform, returning -1 if the uniform is not used by the
+     * program (e.g. left out by a shader variant).
+     */
+    GLint findUniform(const GLchar* name) const noexcept;
+
   public:
-    GLuint program;
+    struct Stats
+    {
+      int cached   = 0; // Loaded from the binary cache
+      int compiled = 0; // Built from the sources
+    };
+
+    /**
+     * Where the program binaries are kept, with its trailing separator. The
+     * cache is disabled if empty.
+     */
+    static std::string BinaryCacheDirectory;
+    static Stats       CacheStats;
+
+  private:
+    bool loadBinary(const std::uint64_t sources, const std::uint64_t driver);
+    void saveBinary(const std::uint64_t sources, const std::uint64_t driver);
+    void reflectUniforms(void);
+
+  public:
+    GLuint        program;
+    std::uint32_t index; // See gl::AcquireObjectIndex
+
+  private:
+    std::vector<Shader>                         shaders;    // Until compiled
+    std::vector<std::pair<GLuint, std::string>> attributes; // Bound ones
+    std::unordered_map<std::string, GLint>      uniforms;   // Active, by name
   };
 
 } // Soleil
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Pvs.hpp"
+
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace Soleil {
+
+  /**
+   * Shape index of the wall cube in the level files
+   */
+  static constexpr int WallShape = 0;
+
+  /**
+   * Points of a cell, in cell units, the rays are cast between: the center
+   * and the four corners slightly inset so a ray along a wall does not touch
+   * it.
+   */
+  static const glm::vec2 Samples[] = {{0.5f, 0.5f},   {0.05f, 0.05f},
+                                      {0.95f, 0.05f}, {0.05f, 0.95f},
+                                      {0.95f, 0.95f}};
+
+  /**
+   * Walk the cells crossed by the segment [from, to] (in cell units, Amanatides
+   * & Woo). Return false if one of them, apart from the two ends, is an
+   * occluder.
+   */
+  static bool RayIsClear(const glm::vec2& from, const glm::vec2& to,
+                         const int width, const int depth,
+                         const std::vector<std::uint8_t>& occluders)
+  {
+    int       x    = static_cast<int>(std::floor(from.x));
+    int       z    = static_cast<int>(std::floor(from.y));
+    const int endX = static_cast<int>(std::floor(to.x));
+    const int endZ = static_cast<int>(std::floor(to.y));
+
+    const glm::vec2 direction = to - from;
+    const int       stepX     = (direction.x > 0.0f) ? 1 : -1;
+    const int       stepZ     = (direction.y > 0.0f) ? 1 : -1;
+    const float     infinity  = std::numeric_limits<float>::infinity();
+
+    const float deltaX =
+      (direction.x != 0.0f) ? std::abs(1.0f / direction.x) : infinity;
+    const float deltaZ =
+      (direction.y != 0.0f) ? std::abs(1.0f / direction.y) : infinity;
+    float nextX = (direction.x != 0.0f)
+                    ? ((stepX > 0) ? (x + 1 - from.x) : (from.x - x)) * deltaX
+                    : infinity;
+    float nextZ = (direction.y != 0.0f)
+                    ? ((stepZ > 0) ? (z + 1 - from.y) : (from.y - z)) * deltaZ
+                    : infinity;
+
+    while (x != endX || z != endZ) {
+      if (nextX < nextZ) {
+        x += stepX;
+        nextX += deltaX;
+      } else {
+        z += stepZ;
+        nextZ += deltaZ;
+      }
+
+      if (x == endX && z == endZ) break;
+      if (x < 0 || z < 0 || x >= width || z >= depth) return false;
+      if (occluders[z * width + x]) return false;
+    }
+    return true;
+  }
+
+  Pvs::Pvs()
+    : origin(0.0f)
+    , cellSize(1.0f)
+    , width(0)
+    , depth(0)
+    , rowWords(0)
+  {
+  }
+
+  Pvs Pvs::Compute(const glm::vec2& origin, const float cellSize,
+                   const int width, const int depth,
+                   const std::vector<std::uint8_t>& occluders,
+                   const float                      maxDistance)
+  {
+    Pvs pvs;
+    pvs.origin   = origin;
+    pvs.cellSize = cellSize;
+    pvs.width    = width;
+    pvs.depth    = depth;
+    pvs.rowWords = (width * depth + 31) / 32;
+    pvs.bits.assign(pvs.rowWords * width * depth, 0u);
+
+    const int   cells = width * depth;
+    const float maxDistance2 =
+      (maxDistance / cellSize + 1.0f) * (maxDistance / cellSize + 1.0f);
+
+    for (int a = 0; a < cells; ++a) {
+      // Nothing is culled from within a wall, should the camera get there
+      if (occluders[a]) {
+        for (int b = 0; b < cells; ++b) pvs.setVisible(a, b);
+        continue;
+      }
+
+      const glm::vec2 cellA(a % width, a / width);
+      pvs.setVisible(a, a);
+      for (int b = a + 1; b < cells; ++b) {
+        const glm::vec2 cellB(b % width, b / width);
+        const glm::vec2 gap = cellB - cellA;
+        if (gap.x * gap.x + gap.y * gap.y > maxDistance2) continue;
+
+        bool visible = false;
+        for (const glm::vec2& from : Samples) {
+          for (const glm::vec2& to : Samples) {
+            if (RayIsClear(cellA + from, cellB + to, width, depth,
+                           occluders)) {
+              visible = true;
+              break;
+            }
+          }
+          if (visible) break;
+        }
+
+        if (visible) {
+          pvs.setVisible(a, b);
+          if (occluders[b] == 0) pvs.setVisible(b, a);
+        }
+      }
+    }
+    return pvs;
+  }
+
+  Pvs Pvs::FromLevel(const std::string& level, const float cellSize,
+                     const float maxDistance)
+  {
+    std::istringstream     s(level);
+    std::string            line;
+    std::vector<glm::vec2> walls;
+    glm::vec2              min(std::numeric_limits<float>::max());
+    glm::vec2              max(std::numeric_limits<float>::lowest());
+
+    // Only the statics, up to the first blank line, may block the view
+    while (std::getline(s, line)) {
+      if (line[0] == '#') continue;
+      if (line.size() < 1) break;
+
+      std::istringstream drawStr(line);
+      int                shapeIndex;
+      glm::mat4          t;
+
+      drawStr >> shapeIndex;
+      for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+          drawStr >> t[x][y];
+        }
+      }
+
+      const glm::vec2 position(t[3][0], t[3][2]);
+      min = glm::min(min, position);
+      max = glm::max(max, position);
+
+      // A wall only hides its cell if it covers it whole
+      const float halfX = std::abs(t[0][0]) + std::abs(t[2][0]);
+      const float halfZ = std::abs(t[0][2]) + std::abs(t[2][2]);
+      if (shapeIndex == WallShape && halfX >= cellSize * 0.5f - 1e-3f &&
+          halfZ >= cellSize * 0.5f - 1e-3f)
+        walls.push_back(position);
+    }
+
+    if (min.x > max.x) return Pvs();
+
+    const glm::vec2 origin = min - cellSize * 0.5f;
+    const int       width =
+      static_cast<int>(std::floor((max.x - origin.x) / cellSize)) + 1;
+    const int depth =
+      static_cast<int>(std::floor((max.y - origin.y) / cellSize)) + 1;
+
+    std::vector<std::uint8_t> occluders(width * depth, 0);
+    for (const glm::vec2& wall : walls) {
+      const glm::vec2 cell   = (wall - origin) / cellSize;
+      const glm::vec2 inCell = cell - glm::floor(cell);
+
+      // Walls off the grid do not fill a cell
+      if (std::abs(inCell.x - 0.5f) > 1e-3f ||
+          std::abs(inCell.y - 0.5f) > 1e-3f)
+        continue;
+
+      occluders[static_cast<int>(cell.y) * width + static_cast<int>(cell.x)] =
+        1;
+    }
+
+    return Compute(origin, cellSize, width, depth, occluders, maxDistance);
+  }
+
+  int Pvs::cellAt(const glm::vec3& position) const noexcept
+  {
+    const int x =
+      static_cast<int>(std::floor((position.x - origin.x) / cellSize));
+    const int z =
+      static_cast<int>(std::floor((position.z - origin.y) / cellSize));
+
+    if (x < 0 || z < 0 || x >= width || z >= depth) return -1;
+    return z * width + x;
+  }
+
+  bool Pvs::isVisible(const int from, const int to) const noexcept
+  {
+    return (bits[from * rowWords + (to >> 5)] >> (to & 31)) & 1u;
+  }
+
+  void Pvs::setVisible(const int from, const int to) noexcept
+  {
+    bits[from * rowWords + (to >> 5)] |= 1u << (to & 31);
+  }
+
+  bool Pvs::isVisible(const glm::vec3& eye, const glm::vec3& position,
+                      const int margin) const noexcept
+  {
+    const int from = cellAt(eye);
+    const int to   = cellAt(position);
+    if (from < 0 || to < 0) return true;
+
+    const int x = to % width;
+    const int z = to / width;
+    for (int j = std::max(0, z - margin); j <= std::min(depth - 1, z + margin);
+         ++j) {
+      for (int i = std::max(0, x - margin);
+           i <= std::min(width - 1, x + margin); ++i) {
+        if (isVisible(from, j * width + i)) return true;
+      }
+    }
+    return false;
+  }
+
+  void Pvs::cull(const glm::vec3& eye, const BoxArray& bounds,
+                 std::vector<std::uint8_t>& visible) const
+  {
+    const int from = cellAt(eye);
+    if (from < 0) return;
+
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+      if (visible[i] == 0) continue;
+
+      // Cells overlapped by the box, clamped to the grid: boxes partly out of
+      // it are kept by the cells at its border.
+      const BoundingBox box    = bounds.get(i);
+      const glm::vec3   boxMin = box.getMin();
+      const glm::vec3   boxMax = box.getMax() - 1e-3f;
+      const int         minX   = glm::clamp(
+        static_cast<int>(std::floor((boxMin.x - origin.x) / cellSize)), 0,
+        width - 1);
+      const int minZ = glm::clamp(
+        static_cast<int>(std::floor((boxMin.z - origin.y) / cellSize)), 0,
+        depth - 1);
+      const int maxX = glm::clamp(
+        static_cast<int>(std::floor((boxMax.x - origin.x) / cellSize)), 0,
+        width - 1);
+      const int maxZ = glm::clamp(
+        static_cast<int>(std::floor((boxMax.z - origin.y) / cellSize)), 0,
+        depth - 1);
+
+      bool seen = false;
+      for (int z = minZ; z <= maxZ && !seen; ++z) {
+        for (int x = minX; x <= maxX && !seen; ++x) {
+          seen = isVisible(from, z * width + x);
+        }
+      }
+      visible[i] = seen;
+    }
+  }
+
+  std::string Pvs::serialize(const std::uint64_t levelHash) const
+  {
+    std::ostringstream out;
+
+    out << "pvs 1 " << std::hex << levelHash << std::dec << " " << origin.x
+        << " " << origin.y << " " << cellSize << " " << width << " " << depth
+        << "\n";
+    out << std::hex << std::setfill('0');
+    for (int cell = 0; cell < width * depth; ++cell) {
+      for (std::size_t w = 0; w < rowWords; ++w) {
+        out << std::setw(8) << bits[cell * rowWords + w];
+      }
+      out << "\n";
+    }
+    return out.str();
+  }
+
+  bool Pvs::Deserialize(const std::string& content,
+                        const std::uint64_t levelHash, Pvs& pvs)
+  {
+    std::istringstream in(content);
+    std::string        magic;
+    int                version = 0;
+    std::uint64_t      hash    = 0;
+    Pvs                read;
+
+    in >> magic >> version >> std::hex >> hash >> std::dec;
+    if (!in || magic != "pvs" || version != 1 || hash != levelHash)
+      return false;
+
+    in >> read.origin.x >> read.origin.y >> read.cellSize >> read.width >>
+      read.depth;
+    if (!in || read.width <= 0 || read.depth <= 0 || read.cellSize <= 0.0f)
+      return false;
+
+    const int cells = read.width * read.depth;
+    read.rowWords   = (cells + 31) / 32;
+    read.bits.resize(read.rowWords * cells);
+
+    std::string row;
+    for (int cell = 0; cell < cells; ++cell) {
+      in >> row;
+      if (!in || row.size() != read.rowWords * 8) return false;
+
+      for (std::size_t w = 0; w < read.rowWords; ++w) {
+        read.bits[cell * read.rowWords + w] = static_cast<std::uint32_t>(
+          std::stoul(row.substr(w * 8, 8), nullptr, 16));
+      }
+    }
+
+    pvs = std::move(read);
+    return true;
+  }
+
+  std::uint64_t Pvs::Hash(const std::string& level) noexcept
+  {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : level) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+} // Soleil
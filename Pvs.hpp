@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SOLEIL__PVS_HPP_
+#define SOLEIL__PVS_HPP_
+
+#include "Culling.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Soleil {
+
+  /**
+   * Potentially visible set of a maze level: for each cell of the level grid,
+   * the cells that can be seen from it.
+   *
+   * The level is cut in square cells on the ground (x, z). Cells holding a
+   * wall or a gate block the view. A cell is visible from another if a ray
+   * between any of their sample points crosses no blocking cell.
+   */
+  class Pvs
+  {
+  public:
+    Pvs();
+
+    /**
+     * Compute the set of a grid of width x depth cells of cellSize units,
+     * starting at origin. occluders[z * width + x] is not 0 for the cells
+     * blocking the view. Cells farther than maxDistance are never visible.
+     */
+    static Pvs Compute(const glm::vec2& origin, const float cellSize,
+                       const int width, const int depth,
+                       const std::vector<std::uint8_t>& occluders,
+                       const float                      maxDistance);
+
+    /**
+     * Compute the set of a level file, walls and gates are the occluders.
+     */
+    static Pvs FromLevel(const std::string& level, const float cellSize,
+                         const float maxDistance);
+
+  public:
+    bool empty(void) const noexcept { return width == 0; }
+
+    /**
+     * Index of the cell holding the position, or -1 out of the grid.
+     */
+    int cellAt(const glm::vec3& position) const noexcept;
+
+    bool isVisible(const int from, const int to) const noexcept;
+
+    /**
+     * True if a cell within margin cells of the position is visible from the
+     * eye. Positions out of the grid are always visible.
+     */
+    bool isVisible(const glm::vec3& eye, const glm::vec3& position,
+                   const int margin) const noexcept;
+
+    /**
+     * Clear visible[i] when no cell overlapped by the box i is visible from
+     * the eye.
+     */
+    void cull(const glm::vec3& eye, const BoxArray& bounds,
+              std::vector<std::uint8_t>& visible) const;
+
+  public:
+    /**
+     * Text form of the set, stored next to the level as <level>.pvs.
+     * levelHash ties it to the content of the level, see Hash.
+     */
+    std::string serialize(const std::uint64_t levelHash) const;
+
+    /**
+     * Read a set written by serialize. Return false if the content is not
+     * valid or was computed from another version of the level.
+     */
+    static bool Deserialize(const std::string& content,
+                            const std::uint64_t levelHash, Pvs& pvs);
+
+    /**
+     * Stable hash of a level (64 bits FNV-1a)
+     */
+    static std::uint64_t Hash(const std::string& level) noexcept;
+
+  private:
+    void setVisible(const int from, const int to) noexcept;
+
+  private:
+    glm::vec2                  origin;
+    float                      cellSize;
+    int                        width;
+    int                        depth;
+    std::size_t                rowWords; // 32 bits words per cell
+    std::vector<std::uint32_t> bits;
+  };
+
+} // Soleil
+
+#endif /* SOLEIL__PVS_HPP_ */
@@ -31,6 +31,7 @@
 #include "Recorder.hpp"
 #include "Shape.hpp"
 #include "SoundService.hpp"
+#include "StateCache.hpp"
 #include "TypesToOStream.hpp"
 #include "WavefrontLoader.hpp"
 #include "World.hpp"
@@ -170,24 +171,54 @@ namespace Soleil {
                     frame.cameraPosition);
     }
     if (ControllerService::GetPlayerController().option3) {
-      glEnable(GL_CULL_FACE);
-      glCullFace(GL_BACK);
-
-      for (const auto& e : world.elements) {
-        RenderFlatShape(e.transformation, *world.shapes[e.shapeIndex], frame);
-      }
-      for (const auto& e : world.items) {
-        RenderFlatShape(e.transformation, *world.shapes[e.shapeIndex], frame);
-      }
-      for (const auto& e : world.ghosts) {
-        RenderFlatShape(e.transformation, *world.shapes[e.shapeIndex], frame);
+      gl::State().enable(GL_CULL_FACE);
+      gl::State().cullFace(GL_BACK);
+
+      const Frustum frustum = Frustum::FromViewProjection(frame.ViewProjection);
+      const Pvs*    pvs     = gval::usePvs ? &world.pvs : nullptr;
+
+      // Only the lights that may reach a cell visible from the camera are
+      // sent. The camera light comes first and is always kept. The frame
+      // holds them while the scene is drawn, the storage of both vectors is
+      // swapped back and forth rather than copied.
+      const bool cullLights = pvs && pvs->empty() == false;
+      if (cullLights) {
+        std::vector<PointLight>& all = world.sceneLights;
+
+        all.swap(frame.pointLights);
+        frame.pointLights.clear();
+        for (std::size_t i = 0; i < all.size(); ++i) {
+          if (i == 0 || pvs->isVisible(frame.cameraPosition, all[i].position,
+                                       gval::pvsLightMargin))
+            frame.pointLights.push_back(all[i]);
+        }
       }
+
+      RenderQueue& queue = world.queue;
+      queue.clear();
+      if (world.bakedStatics.empty()) {
+        queue.push(world.elements, world.shapes, world.elementBounds, frustum,
+                   frame, pvs);
+        queue.push(world.mergedWalls, world.mergedWallBounds, frustum, frame,
+                   pvs);
+      } else
+        queue.push(world.bakedStatics, world.bakedBounds, frustum, frame,
+                   pvs);
+      queue.push(world.items, world.shapes, world.itemBounds, frustum, frame,
+                 pvs);
+      // The ghosts move, the other elements keep their normal matrices
+      for (auto& ghost : world.ghosts) ghost.updateNormalMatrix();
+      queue.push(world.ghosts, world.shapes, frame);
+      queue.sort();
+      queue.flush(frame);
+
+      if (cullLights) frame.pointLights.swap(world.sceneLights);
     }
 
 #ifndef NDEBUG
     // On development allow to draw bonding box of elements
     if (ControllerService::GetPlayerController().option4) {
-      glDisable(GL_DEPTH_TEST);
+      gl::State().disable(GL_DEPTH_TEST);
 
       for (const auto& box : world.hardSurfaces) {
         DrawBoundingBox(box, frame);
@@ -343,13 +374,7 @@ namespace Soleil {
               toWString(L"BUTIN: ", goldScore, L" / 260"), goldLabel,
               OpenGLDataInstance::Instance().textAtlas, gval::textLabelSize);
 
-            for (auto it = world.items.begin(); it != world.items.end(); ++it) {
-              const auto& coinItem = *it;
-              if (coinItem.id == trigger->link) {
-                world.items.erase(it);
-                break;
-              }
-            }
+            RemoveItem(world, trigger->link);
 
             doIncrement = false;
             world.coinPickedUp.push_back(trigger->link);
@@ -388,13 +413,7 @@ namespace Soleil {
 
           } break;
           case TriggerType::Key: {
-            for (auto it = world.items.begin(); it != world.items.end(); ++it) {
-              const auto& coinItem = *it;
-              if (coinItem.id == trigger->link) {
-                world.items.erase(it);
-                break;
-              }
-            }
+            RemoveItem(world, trigger->link);
             doIncrement       = false;
             world.keyPickedUp = true;
             world.triggers.erase(trigger);
@@ -446,6 +465,9 @@ namespace Soleil {
     frame.delta = time - frame.time;
     frame.time  = time;
 
+    // The platform and the previous frame may have changed the state aside
+    gl::State().invalidate();
+
     int currentState = state;
     if (currentState & State::StateInitializing) initializeGame(time);
     if (currentState & State::StateGame) renderGame(time);
@@ -497,11 +519,20 @@ namespace Soleil {
 
       if (time - firstTime > oneSec) {
         const auto duration = TotalDuration / frames;
+        const RenderQueue::Stats&    stats   = world.queue.getStats();
+        const gl::StateCache::Stats& glStats = gl::State().getStats();
         SOLEIL__LOGGER_DEBUG("Time to draw previous frame: ", duration,
-                             " (FPS=", frames, ") --", frame.pointLights.size());
+                             " (FPS=", frames, ") --", frame.pointLights.size(),
+                             " drawn=", stats.drawn, " culled=", stats.culled,
+                             " gl calls=", glStats.calls / frames,
+                             " elided=", glStats.elided / frames);
         FillBuffer(toWString("TIME TO DRAW PREVIOUS FRAME: ", duration,
-                             " (FPS=", frames, ")--", frame.pointLights.size()),
+                             " (FPS=", frames, ")--", frame.pointLights.size(),
+                             " DRAWN: ", stats.drawn, " CULLED: ", stats.culled,
+                             " GL CALLS: ", glStats.calls / frames,
+                             " ELIDED: ", glStats.elided / frames),
                    textCommand, OpenGLDataInstance::Instance().textAtlas, 0.8f);
+        gl::State().resetStats();
         firstTime     = time;
         frames        = 0;
         TotalDuration = Timer(0);
@@ -515,6 +546,7 @@ namespace Soleil {
       SOLEIL__CONSOLE_DRAW();
     }
 #endif
+    throwOnFrameGlError();
   }
 
   void Ruine::initializeGame(const Timer& /*time*/)
@@ -599,8 +631,8 @@ namespace Soleil {
       frame.updateViewProjectionMatrices(view, projection);
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    gl::State().enable(GL_DEPTH_TEST);
+    gl::State().depthFunc(GL_LESS);
 
     // --------------- Render Scene ---------------
     RenderScene(world, frame);
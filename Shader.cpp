@@ -28,19 +28,55 @@
 namespace Soleil {
 
   Shader::Shader(GLenum shaderType, const std::string& fileName)
-    : shader(glCreateShader(shaderType))
+    : type(shaderType)
+    , shader(0)
     , name(fileName)
+    , source(AssetService::LoadAsString(fileName))
   {
-    const std::string source = AssetService::LoadAsString(fileName);
-    const GLchar* sources[] = {static_cast<const GLchar*>(source.c_str())};
+  }
 
-    glShaderSource(shader, 1, sources, nullptr);
+  Shader::Shader(GLenum shaderType, const std::string& fileName,
+                 const std::vector<std::string>& defines)
+    : type(shaderType)
+    , shader(0)
+    , name(fileName)
+    , source(AssetService::LoadAsString(fileName))
+  {
+    // The #version has to stay the first statement
+    std::size_t position = 0;
+    if (source.compare(0, 8, "#version") == 0) {
+      position = source.find('\n');
+      position = (position == std::string::npos) ? source.size() : position + 1;
+    }
+
+    std::string header;
+    for (const auto& define : defines) {
+      header += "#define " + define + "\n";
+      name += " " + define;
+    }
+    source.insert(position, header);
   }
 
-  Shader::~Shader() { glDeleteShader(shader); }
+  Shader::Shader(const Shader& other)
+    : type(other.type)
+    , shader(0)
+    , name(other.name)
+    , source(other.source)
+  {
+  }
+
+  Shader::~Shader()
+  {
+    if (shader) glDeleteShader(shader);
+  }
 
   GLuint Shader::operator*() const
   {
+    if (shader) return shader;
+
+    const GLchar* sources[] = {static_cast<const GLchar*>(source.c_str())};
+    shader                  = glCreateShader(type);
+    glShaderSource(shader, 1, sources, nullptr);
     glCompileShader(shader);
 
     GLint isCompiled = 0;
@@ -24,20 +24,38 @@
 
 #include "OpenGLInclude.hpp"
 
+#include <vector>
+
 namespace Soleil {
 
+  /**
+   * Source of a shader, compiled on the first call to operator*. A copy only
+   * holds the source.
+   */
   class Shader
   {
   public:
     Shader(GLenum shaderType, const std::string& source);
+
+    /**
+     * Build a variant of the shader: each define ("NAME" or "NAME VALUE") is
+     * inserted as a #define right after the #version line.
+     */
+    Shader(GLenum shaderType, const std::string& source,
+           const std::vector<std::string>& defines);
+    Shader(const Shader& other);
+    Shader& operator=(const Shader&) = delete;
     virtual ~Shader();
 
   public:
-    GLuint operator*(void) const;
+    GLuint             operator*(void) const;
+    const std::string& getSource(void) const noexcept { return source; }
 
   private:
-    GLuint      shader;
-    std::string name;
+    GLenum         type;
+    mutable GLuint shader; // 0 until compiled
+    std::string    name;
+    std::string    source;
   };
 
 } // Soleil
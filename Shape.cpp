@@ -21,40 +21,206 @@
 
 #include "Shape.hpp"
 
+#include "StateCache.hpp"
+
+#include <glm/common.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
 namespace Soleil {
 
+  namespace VertexFormat {
+
+    // Offsets in a packed vertex
+    static constexpr GLsizei NormalOffset = 3 * sizeof(GLfloat);
+    static constexpr GLsizei UvOffset     = NormalOffset + 4;
+
+    static GLsizei ColorOffset(const std::uint8_t format) noexcept
+    {
+      return UvOffset + ((format & FloatUv) ? 2 * sizeof(GLfloat)
+                                            : 2 * sizeof(GLshort));
+    }
+
+    std::uint8_t Select(const std::vector<Vertex>& vertices)
+    {
+      std::uint8_t format = 0;
+
+      for (const auto& v : vertices) {
+        if (v.color != vertices.front().color) format |= Color;
+        // Also keeps the -42 sentinel of the vertices without uv
+        if (std::abs(v.uv.x) > VertexUvRange ||
+            std::abs(v.uv.y) > VertexUvRange)
+          format |= FloatUv;
+      }
+      return format;
+    }
+
+    GLsizei Stride(const std::uint8_t format) noexcept
+    {
+      return ColorOffset(format) + ((format & Color) ? 4 : 0);
+    }
+
+    template <typename T>
+    static T Normalize(const float value) noexcept
+    {
+      constexpr float max = std::numeric_limits<T>::max();
+      return (T)std::round(glm::clamp(value, -1.0f, 1.0f) * max);
+    }
+
+    void Pack(const std::vector<Vertex>& vertices, const std::uint8_t format,
+              std::vector<std::uint8_t>& bytes)
+    {
+      const GLsizei     stride = Stride(format);
+      const std::size_t first  = bytes.size();
+      bytes.resize(first + stride * vertices.size());
+
+      std::uint8_t* out = bytes.data() + first;
+      for (const auto& v : vertices) {
+        const GLfloat position[] = {v.position.x, v.position.y, v.position.z};
+        const GLbyte  normal[]   = {Normalize<GLbyte>(v.normal.x),
+                                 Normalize<GLbyte>(v.normal.y),
+                                 Normalize<GLbyte>(v.normal.z), 0};
+        const glm::vec2 uv = v.uv / VertexUvRange;
+
+        std::memcpy(out, position, sizeof(position));
+        std::memcpy(out + NormalOffset, normal, sizeof(normal));
+        if (format & FloatUv) {
+          const GLfloat floats[] = {uv.x, uv.y};
+          std::memcpy(out + UvOffset, floats, sizeof(floats));
+        } else {
+          const GLshort shorts[] = {Normalize<GLshort>(uv.x),
+                                    Normalize<GLshort>(uv.y)};
+          std::memcpy(out + UvOffset, shorts, sizeof(shorts));
+        }
+        if (format & Color) {
+          const GLubyte color[] = {
+            (GLubyte)std::round(glm::clamp(v.color.r, 0.0f, 1.0f) * 255.0f),
+            (GLubyte)std::round(glm::clamp(v.color.g, 0.0f, 1.0f) * 255.0f),
+            (GLubyte)std::round(glm::clamp(v.color.b, 0.0f, 1.0f) * 255.0f),
+            (GLubyte)std::round(glm::clamp(v.color.a, 0.0f, 1.0f) * 255.0f)};
+          std::memcpy(out + ColorOffset(format), color, sizeof(color));
+        }
+        out += stride;
+      }
+    }
+
+  } // VertexFormat
+
+  void SetVertexAttributes(const SubShapeRange& range)
+  {
+    const std::uint8_t format = range.format;
+    const GLsizei      stride = VertexFormat::Stride(format);
+    const GLintptr     offset = range.vertexOffset;
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                          (const GLvoid*)offset);
+    glVertexAttribPointer(
+      1, 3, GL_BYTE, GL_TRUE, stride,
+      (const GLvoid*)(offset + VertexFormat::NormalOffset));
+    if (format & VertexFormat::FloatUv) {
+      glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride,
+                            (const GLvoid*)(offset + VertexFormat::UvOffset));
+    } else {
+      glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride,
+                            (const GLvoid*)(offset + VertexFormat::UvOffset));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(3);
+
+    if (format & VertexFormat::Color) {
+      glVertexAttribPointer(
+        2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+        (const GLvoid*)(offset + VertexFormat::ColorOffset(format)));
+      glEnableVertexAttribArray(2);
+    } else {
+      glDisableVertexAttribArray(2);
+    }
+  }
+
   Shape::Shape(const std::vector<SubShape>& subShapes)
     : Object(GetType(), GetClassName())
     , subShapes(subShapes)
     , buffer()
+    , indexBuffer()
+    , bounds(makeBoundingBox())
   {
     // TODO: In case of GL Context reseted we need to renew the buffer
     gl::BindBuffer bindBuffer(GL_ARRAY_BUFFER, *buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+    gl::BindBuffer bindIndexBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBuffer);
 
-    GLsizeiptr size = 0;
+    // Each SubShape in its own format, packed one after the other
+    std::vector<std::uint8_t> vertices;
+    GLsizeiptr                indexSize = 0;
     for (const auto& sub : subShapes) {
-      size += sizeof(sub.vertices[0]) * sub.vertices.size();
+      const std::uint8_t format = VertexFormat::Select(sub.vertices);
+      const glm::vec4    color =
+        sub.vertices.empty() ? glm::vec4(1.0f) : sub.vertices.front().color;
+
+      ranges.push_back({(GLintptr)vertices.size(), indexSize,
+                        (GLsizei)sub.indices.size(), 0, format, color});
+
+      VertexFormat::Pack(sub.vertices, format, vertices);
+      indexSize += sizeof(GLushort) * sub.indices.size();
     }
 
-    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    // The models never change once loaded
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+                 GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, nullptr, GL_STATIC_DRAW);
 
-    GLintptr offset = 0;
-    for (const auto& sub : subShapes) {
-      GLsizeiptr componentSize = sizeof(sub.vertices[0]) * sub.vertices.size();
+    for (std::size_t i = 0; i < subShapes.size(); ++i) {
+      const SubShape&      sub   = subShapes[i];
+      const SubShapeRange& range = ranges[i];
 
-      glBufferSubData(GL_ARRAY_BUFFER, offset, componentSize,
-                      sub.vertices.data());
-      offset += componentSize;
+      glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.indexOffset,
+                      sizeof(GLushort) * sub.indices.size(),
+                      sub.indices.data());
     }
+    throwOnGlError();
+
+    // One vertex array per SubShape as each one starts at its own offset
+    vertexArrays.resize(subShapes.size());
+    gl::GlGenVertexArrays(vertexArrays.size(), vertexArrays.data());
+    for (std::size_t i = 0; i < subShapes.size(); ++i) {
+      if (vertexArrays[i] == 0) break;
 
+      ranges[i].vertexArray = vertexArrays[i];
+      gl::GlBindVertexArray(vertexArrays[i]);
+      gl::State().bindBuffer(GL_ARRAY_BUFFER, *buffer);
+      gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBuffer);
+      SetVertexAttributes(ranges[i]);
+    }
+    gl::GlBindVertexArray(0);
     throwOnGlError();
   }
 
-  Shape::~Shape() {}
+  Shape::~Shape()
+  {
+    gl::GlDeleteVertexArrays(vertexArrays.size(), vertexArrays.data());
+  }
 
   GLuint Shape::getBuffer() const noexcept { return *buffer; }
 
+  std::uint32_t Shape::getBufferIndex() const noexcept
+  {
+    return buffer.index();
+  }
+
+  GLuint Shape::getIndexBuffer() const noexcept { return *indexBuffer; }
+
+  const SubShapeRange& Shape::getRange(const SubShape& sub) const noexcept
+  {
+    const std::size_t index = &sub - subShapes.data();
+    assert(index < ranges.size() && "SubShape of another Shape");
+
+    return ranges[index];
+  }
+
   const std::vector<SubShape>& Shape::getSubShapes(void) const noexcept
   {
     return this->subShapes;
@@ -25,11 +25,13 @@
 #include "BoundingBox.hpp"
 #include "Object.hpp"
 #include "OpenGLInclude.hpp"
+#include "TextureCache.hpp"
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -65,6 +67,23 @@ namespace Soleil {
     }
   };
 
+  /**
+   * Features of a material, each one enabling a #define of the flat shape
+   * shaders. Set once at load so the material picks its shader variant.
+   */
+  namespace MaterialFeature {
+    enum : std::uint8_t
+    {
+      Textured   = 1 << 0, // TEXTURED, diffuseMap is set
+      AlphaBlend = 1 << 1, // ALPHA_BLEND, translucent (MTL d below 1, map_d)
+      BakedLight = 1 << 2, // BAKED_LIGHT, the vertex colors hold the light
+    };
+  } // MaterialFeature
+
+  // The baked light is stored in the vertex colors divided by this value
+  // (LIGHTRANGE in the shaders), so it may exceed 1.
+  static constexpr float BakedLightRange = 2.0f;
+
   struct Material
   {
     glm::vec3 ambiantColor;
@@ -72,8 +91,11 @@ namespace Soleil {
     glm::vec3 specularColor;
     glm::vec3 emissiveColor;
     float     shininess;
+    float     opacity; // Only used by the AlphaBlend materials
 
-    GLint diffuseMap;
+    GLint        diffuseMap;
+    TexturePtr   texture;  // Keeps diffuseMap alive, see TextureCache
+    std::uint8_t features; // MaterialFeature flags
 
     Material()
       : ambiantColor(0.0f)
@@ -81,8 +103,25 @@ namespace Soleil {
       , specularColor(0.0f)
       , emissiveColor(0.0f)
       , shininess(1.0f)
+      , opacity(1.0f)
       , diffuseMap(-1)
+      , features(0)
+    {
+    }
+
+    bool operator==(const Material& other) const noexcept
     {
+      return ambiantColor == other.ambiantColor &&
+             diffuseColor == other.diffuseColor &&
+             specularColor == other.specularColor &&
+             emissiveColor == other.emissiveColor &&
+             shininess == other.shininess && opacity == other.opacity &&
+             diffuseMap == other.diffuseMap && features == other.features;
+    }
+
+    bool operator!=(const Material& other) const noexcept
+    {
+      return !(*this == other);
     }
   };
 
@@ -93,6 +132,55 @@ namespace Soleil {
     Material              material;
   };
 
+  // The uv are stored divided by this value (UVRANGE in the shaders) so the
+  // ones within it fit in normalized shorts.
+  static constexpr float VertexUvRange = 2.0f;
+
+  /**
+   * Layout of the vertices in the buffer of a Shape. Each one holds its
+   * position (3 floats), its normal (4 normalized bytes, w unused) and its uv
+   * divided by VertexUvRange, then its color if the SubShape has several.
+   */
+  namespace VertexFormat {
+    enum : std::uint8_t
+    {
+      Color   = 1 << 0, // 4 normalized bytes, else SubShapeRange::color
+      FloatUv = 1 << 1, // 2 floats, else 2 normalized shorts
+    };
+
+    /**
+     * Smallest format holding the vertices without loss
+     */
+    std::uint8_t Select(const std::vector<Vertex>& vertices);
+    GLsizei      Stride(const std::uint8_t format) noexcept;
+
+    /**
+     * Append the vertices in the format to the bytes
+     */
+    void Pack(const std::vector<Vertex>& vertices, const std::uint8_t format,
+              std::vector<std::uint8_t>& bytes);
+  } // VertexFormat
+
+  /**
+   * Where the data of a SubShape lies in the buffers of its Shape
+   */
+  struct SubShapeRange
+  {
+    GLintptr     vertexOffset; // In bytes, in the vertex buffer
+    GLintptr     indexOffset;  // In bytes, in the index buffer
+    GLsizei      count;        // Number of indices
+    GLuint       vertexArray;  // Both buffers and the attributes, 0 if missing
+    std::uint8_t format;       // VertexFormat of its vertices
+    glm::vec4    color; // Of all its vertices without VertexFormat::Color
+  };
+
+  /**
+   * Point the attributes 0 to 3 (position, normal, color and uv) to the
+   * vertices of the range in the bound GL_ARRAY_BUFFER. Without vertex colors
+   * the color attribute array is disabled.
+   */
+  void SetVertexAttributes(const SubShapeRange& range);
+
   /**
    * Shape holds informations on a 3D Model object.
    *
@@ -107,11 +195,27 @@ namespace Soleil {
   public:
     const std::vector<SubShape>& getSubShapes(void) const noexcept;
     GLuint                       getBuffer() const noexcept;
+    std::uint32_t                getBufferIndex() const noexcept;
+    GLuint                       getIndexBuffer() const noexcept;
     BoundingBox                  makeBoundingBox(void) const noexcept;
 
+    /**
+     * Same as makeBoundingBox, computed once at construction
+     */
+    const BoundingBox& getBounds(void) const noexcept { return bounds; }
+
+    /**
+     * Range of one of the SubShapes returned by getSubShapes
+     */
+    const SubShapeRange& getRange(const SubShape& sub) const noexcept;
+
   private:
-    std::vector<SubShape> subShapes;
-    gl::Buffer            buffer;
+    std::vector<SubShape>      subShapes;
+    std::vector<SubShapeRange> ranges;
+    std::vector<GLuint>        vertexArrays;
+    gl::Buffer                 buffer;
+    gl::Buffer                 indexBuffer;
+    BoundingBox                bounds;
 
   public:
     static HashType GetType(void) noexcept { return typeid(Shape).hash_code(); }
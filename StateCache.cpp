@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "StateCache.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Soleil {
+  namespace gl {
+
+    // GL_VERTEX_ARRAY_BINDING (GLES 3), same value for the OES extension
+    static constexpr GLenum VertexArrayBinding = 0x85B5;
+
+    constexpr int StateCache::Unknown;
+    constexpr int StateCache::TextureUnits;
+    constexpr int StateCache::Attributes;
+
+    static void ThrowOutOfSync(const char* state, GLint shadow, GLint actual)
+    {
+      throw std::runtime_error(toString("GL state cache out of sync on ", state,
+                                        ": ", shadow, " instead of ", actual));
+    }
+
+    static void Check(const char* state, GLenum name, GLint shadow)
+    {
+      GLint actual = 0;
+      glGetIntegerv(name, &actual);
+      if (actual != shadow) ThrowOutOfSync(state, shadow, actual);
+    }
+
+    static void ThrowUniformOutOfSync(GLint location)
+    {
+      throw std::runtime_error(
+        toString("GL state cache out of sync on uniform ", location));
+    }
+
+    static GLenum CapabilityName(int capability)
+    {
+      static const GLenum names[] = {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE};
+      return names[capability];
+    }
+
+    StateCache::StateCache()
+      : validation(false)
+    {
+      invalidate();
+    }
+
+    bool StateCache::elide(bool same)
+    {
+      stats.calls++;
+      if (same) stats.elided++;
+      return same;
+    }
+
+    void StateCache::useProgram(GLuint name)
+    {
+      if (elide(program == (GLint)name)) {
+        if (validation) Check("program", GL_CURRENT_PROGRAM, program);
+        return;
+      }
+
+      glUseProgram(name);
+      program         = name;
+      programUniforms = &uniforms[name];
+    }
+
+    void StateCache::set(GLenum name, bool enabled)
+    {
+      int capability = 0;
+      while (capability < Capabilities && CapabilityName(capability) != name)
+        capability++;
+
+      if (capability == Capabilities) {
+        // Not shadowed
+        if (enabled)
+          glEnable(name);
+        else
+          glDisable(name);
+        return;
+      }
+
+      if (elide(capabilities[capability] == enabled)) {
+        if (validation && glIsEnabled(name) != enabled)
+          ThrowOutOfSync("capability", enabled, !enabled);
+        return;
+      }
+
+      if (enabled)
+        glEnable(name);
+      else
+        glDisable(name);
+      capabilities[capability] = enabled;
+    }
+
+    void StateCache::enable(GLenum capability) { set(capability, true); }
+
+    void StateCache::disable(GLenum capability) { set(capability, false); }
+
+    void StateCache::blendFunc(GLenum source, GLenum destination)
+    {
+      if (elide(blendSource == (GLint)source &&
+                blendDestination == (GLint)destination)) {
+        if (validation) {
+          Check("blend source", GL_BLEND_SRC_RGB, blendSource);
+          Check("blend destination", GL_BLEND_DST_RGB, blendDestination);
+        }
+        return;
+      }
+
+      glBlendFunc(source, destination);
+      blendSource      = source;
+      blendDestination = destination;
+    }
+
+    void StateCache::cullFace(GLenum face)
+    {
+      if (elide(cullFaceMode == (GLint)face)) {
+        if (validation) Check("cull face", GL_CULL_FACE_MODE, cullFaceMode);
+        return;
+      }
+
+      glCullFace(face);
+      cullFaceMode = face;
+    }
+
+    void StateCache::depthFunc(GLenum function)
+    {
+      if (elide(depthFunction == (GLint)function)) {
+        if (validation) Check("depth function", GL_DEPTH_FUNC, depthFunction);
+        return;
+      }
+
+      glDepthFunc(function);
+      depthFunction = function;
+    }
+
+    void StateCache::activeTexture(GLenum unit)
+    {
+      const GLint index = unit - GL_TEXTURE0;
+      if (elide(activeUnit == index)) {
+        if (validation) Check("active texture", GL_ACTIVE_TEXTURE, unit);
+        return;
+      }
+
+      glActiveTexture(unit);
+      activeUnit = (index < TextureUnits) ? index : Unknown;
+    }
+
+    void StateCache::bindTexture(GLenum target, GLuint texture)
+    {
+      if (target != GL_TEXTURE_2D || activeUnit == Unknown) {
+        stats.calls++;
+        glBindTexture(target, texture);
+        if (target == GL_TEXTURE_2D)
+          std::fill(textures, textures + TextureUnits, Unknown);
+        return;
+      }
+
+      if (elide(textures[activeUnit] == (GLint)texture)) {
+        if (validation)
+          Check("texture", GL_TEXTURE_BINDING_2D, textures[activeUnit]);
+        return;
+      }
+
+      glBindTexture(target, texture);
+      textures[activeUnit] = texture;
+    }
+
+    void StateCache::bindBuffer(GLenum target, GLuint buffer)
+    {
+      GLint* shadow = (target == GL_ARRAY_BUFFER)
+                        ? &arrayBuffer
+                        : (target == GL_ELEMENT_ARRAY_BUFFER) ? &elementBuffer
+                                                              : nullptr;
+      if (shadow == nullptr) {
+        stats.calls++;
+        glBindBuffer(target, buffer);
+        return;
+      }
+
+      if (elide(*shadow == (GLint)buffer)) {
+        if (validation)
+          Check("buffer",
+                (target == GL_ARRAY_BUFFER) ? GL_ARRAY_BUFFER_BINDING
+                                            : GL_ELEMENT_ARRAY_BUFFER_BINDING,
+                *shadow);
+        return;
+      }
+
+      glBindBuffer(target, buffer);
+      *shadow = buffer;
+    }
+
+    void StateCache::bindVertexArray(GLuint name)
+    {
+      if (GetExtensions().vertexArrayObject == false) return;
+
+      if (elide(vertexArray == (GLint)name)) {
+        if (validation) Check("vertex array", VertexArrayBinding, vertexArray);
+        return;
+      }
+
+      GetExtensions().bindVertexArray(name);
+      vertexArray = name;
+      // The index buffer binding belongs to the vertex array
+      elementBuffer = Unknown;
+    }
+
+    StateCache::Uniform* StateCache::uniformSlot(GLint location)
+    {
+      if (location < 0 || programUniforms == nullptr) return nullptr;
+
+      if ((std::size_t)location >= programUniforms->size())
+        programUniforms->resize(location + 1);
+      return &(*programUniforms)[location];
+    }
+
+    void StateCache::validateUniform(GLint location, const glm::vec4& value,
+                                     bool integer) const
+    {
+      glm::vec4 actual(0.0f);
+      if (integer) {
+        GLint i = 0;
+        glGetUniformiv(program, location, &i);
+        actual.x = (float)i;
+      } else
+        glGetUniformfv(program, location, glm::value_ptr(actual));
+
+      // Components not set by the call are 0 on both sides
+      if (value != actual) ThrowUniformOutOfSync(location);
+    }
+
+    void StateCache::uniform(GLint location, GLint value)
+    {
+      Uniform*        slot = uniformSlot(location);
+      const glm::vec4 v((float)value, 0.0f, 0.0f, 0.0f);
+
+      if (elide(slot && slot->known && slot->value == v)) {
+        if (validation) validateUniform(location, v, true);
+        return;
+      }
+
+      glUniform1i(location, value);
+      if (slot) *slot = {v, true};
+    }
+
+    void StateCache::uniform(GLint location, GLfloat value)
+    {
+      Uniform*        slot = uniformSlot(location);
+      const glm::vec4 v(value, 0.0f, 0.0f, 0.0f);
+
+      if (elide(slot && slot->known && slot->value.x == value)) {
+        if (validation) validateUniform(location, v, false);
+        return;
+      }
+
+      glUniform1f(location, value);
+      if (slot) *slot = {v, true};
+    }
+
+    void StateCache::uniform(GLint location, const glm::vec3& value)
+    {
+      Uniform*        slot = uniformSlot(location);
+      const glm::vec4 v(value, 0.0f);
+
+      if (elide(slot && slot->known && slot->value == v)) {
+        if (validation) validateUniform(location, v, false);
+        return;
+      }
+
+      glUniform3fv(location, 1, glm::value_ptr(value));
+      if (slot) *slot = {v, true};
+    }
+
+    void StateCache::uniform(GLint location, const glm::vec4& value)
+    {
+      Uniform* slot = uniformSlot(location);
+
+      if (elide(slot && slot->known && slot->value == value)) {
+        if (validation) validateUniform(location, value, false);
+        return;
+      }
+
+      glUniform4fv(location, 1, glm::value_ptr(value));
+      if (slot) *slot = {value, true};
+    }
+
+    void StateCache::vertexAttrib(GLuint index, const glm::vec4& value)
+    {
+      if (index >= Attributes) {
+        stats.calls++;
+        glVertexAttrib4fv(index, glm::value_ptr(value));
+        return;
+      }
+
+      Uniform& slot = attributes[index];
+      if (elide(slot.known && slot.value == value)) {
+        if (validation) {
+          glm::vec4 actual(0.0f);
+          glGetVertexAttribfv(index, GL_CURRENT_VERTEX_ATTRIB,
+                              glm::value_ptr(actual));
+          if (actual != value)
+            throw std::runtime_error(
+              toString("GL state cache out of sync on attribute ", index));
+        }
+        return;
+      }
+
+      glVertexAttrib4fv(index, glm::value_ptr(value));
+      slot = {value, true};
+    }
+
+    void StateCache::invalidate(void) noexcept
+    {
+      program          = Unknown;
+      blendSource      = Unknown;
+      blendDestination = Unknown;
+      cullFaceMode     = Unknown;
+      depthFunction    = Unknown;
+      activeUnit       = Unknown;
+      arrayBuffer      = Unknown;
+      elementBuffer    = Unknown;
+      vertexArray      = Unknown;
+      programUniforms  = nullptr;
+      std::fill(capabilities, capabilities + Capabilities, Unknown);
+      std::fill(textures, textures + TextureUnits, Unknown);
+      std::fill(attributes, attributes + Attributes, Uniform());
+      // Uniforms are kept: only their program may change them
+    }
+
+    void StateCache::forgetProgram(GLuint name)
+    {
+      if (program == (GLint)name) {
+        program         = Unknown;
+        programUniforms = nullptr;
+      }
+      uniforms.erase(name);
+    }
+
+    void StateCache::forgetTexture(GLuint texture) noexcept
+    {
+      // Deleting a bound texture binds 0 in its place
+      std::replace(textures, textures + TextureUnits, (GLint)texture, 0);
+    }
+
+    void StateCache::forgetBuffer(GLuint buffer) noexcept
+    {
+      if (arrayBuffer == (GLint)buffer) arrayBuffer = 0;
+      if (elementBuffer == (GLint)buffer) elementBuffer = Unknown;
+    }
+
+    void StateCache::forgetVertexArray(GLuint name) noexcept
+    {
+      if (vertexArray == (GLint)name) {
+        vertexArray   = 0;
+        elementBuffer = Unknown;
+      }
+    }
+
+    void StateCache::validate(void) const
+    {
+      if (program != Unknown) Check("program", GL_CURRENT_PROGRAM, program);
+      for (int c = 0; c < Capabilities; ++c) {
+        if (capabilities[c] != Unknown &&
+            (GLint)glIsEnabled(CapabilityName(c)) != capabilities[c])
+          ThrowOutOfSync("capability", capabilities[c], !capabilities[c]);
+      }
+      if (blendSource != Unknown) {
+        Check("blend source", GL_BLEND_SRC_RGB, blendSource);
+        Check("blend destination", GL_BLEND_DST_RGB, blendDestination);
+      }
+      if (cullFaceMode != Unknown)
+        Check("cull face", GL_CULL_FACE_MODE, cullFaceMode);
+      if (depthFunction != Unknown)
+        Check("depth function", GL_DEPTH_FUNC, depthFunction);
+      if (activeUnit != Unknown) {
+        Check("active texture", GL_ACTIVE_TEXTURE, GL_TEXTURE0 + activeUnit);
+        if (textures[activeUnit] != Unknown)
+          Check("texture", GL_TEXTURE_BINDING_2D, textures[activeUnit]);
+      }
+      if (arrayBuffer != Unknown)
+        Check("buffer", GL_ARRAY_BUFFER_BINDING, arrayBuffer);
+      if (elementBuffer != Unknown)
+        Check("buffer", GL_ELEMENT_ARRAY_BUFFER_BINDING, elementBuffer);
+      if (vertexArray != Unknown && GetExtensions().vertexArrayObject)
+        Check("vertex array", VertexArrayBinding, vertexArray);
+
+      if (program == Unknown || programUniforms == nullptr) return;
+      for (std::size_t location = 0; location < programUniforms->size();
+           ++location) {
+        const Uniform& u = (*programUniforms)[location];
+        if (u.known == false) continue;
+
+        // The type is unknown here, compare as floats
+        glm::vec4 actual(0.0f);
+        glGetUniformfv(program, location, glm::value_ptr(actual));
+        if (actual.x != u.value.x) ThrowUniformOutOfSync(location);
+      }
+    }
+
+    StateCache& State(void) noexcept
+    {
+      static StateCache state;
+      return state;
+    }
+
+  } // gl
+} // Soleil
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SOLEIL__STATECACHE_HPP_
+#define SOLEIL__STATECACHE_HPP_
+
+#include "OpenGLInclude.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Soleil {
+  namespace gl {
+
+    /**
+     * Shadow of the GL state most changed by the renderer, skipping the calls
+     * that would set the value already in place.
+     *
+     * The shadow is only right as long as the state is changed through it:
+     * invalidate() has to be called after code using GL directly (ImGui, ...)
+     * and is called at the start of each frame.
+     */
+    class StateCache
+    {
+    public:
+      StateCache();
+
+    public:
+      void useProgram(GLuint program);
+      void enable(GLenum capability);
+      void disable(GLenum capability);
+      void blendFunc(GLenum source, GLenum destination);
+      void cullFace(GLenum face);
+      void depthFunc(GLenum function);
+      void activeTexture(GLenum unit);
+      void bindTexture(GLenum target, GLuint texture);
+      void bindBuffer(GLenum target, GLuint buffer);
+      void bindVertexArray(GLuint vertexArray);
+
+      /**
+       * Uniforms of the current program. Their values are kept per program,
+       * so switching program does not resend them.
+       */
+      void uniform(GLint location, GLint value);
+      void uniform(GLint location, GLfloat value);
+      void uniform(GLint location, const glm::vec3& value);
+      void uniform(GLint location, const glm::vec4& value);
+
+      /**
+       * Constant value of an attribute, used while its array is disabled
+       */
+      void vertexAttrib(GLuint index, const glm::vec4& value);
+
+      /**
+       * Forget the whole shadow, the next calls are all sent
+       */
+      void invalidate(void) noexcept;
+
+      /**
+       * Forget a deleted object, its name may be reused
+       */
+      void forgetProgram(GLuint program);
+      void forgetTexture(GLuint texture) noexcept;
+      void forgetBuffer(GLuint buffer) noexcept;
+      void forgetVertexArray(GLuint vertexArray) noexcept;
+
+      /**
+       * Debug mode: query GL (glGet*) before eliding a call, and throw if the
+       * shadow does not match.
+       */
+      void setValidation(bool enabled) noexcept { validation = enabled; }
+
+      /**
+       * Compare the whole shadow to the GL state, throw on mismatch
+       */
+      void validate(void) const;
+
+      struct Stats
+      {
+        std::size_t calls  = 0; // Calls requested
+        std::size_t elided = 0; // Of which were skipped
+      };
+      const Stats& getStats(void) const noexcept { return stats; }
+      void         resetStats(void) noexcept { stats = Stats(); }
+
+    private:
+      static constexpr int Unknown      = -1;
+      static constexpr int TextureUnits = 8;
+      static constexpr int Attributes   = 8;
+
+      enum Capability
+      {
+        Blend,
+        DepthTest,
+        CullFace,
+        Capabilities
+      };
+
+      struct Uniform
+      {
+        glm::vec4 value;
+        bool      known = false;
+      };
+
+    private:
+      bool elide(bool same);
+      void set(GLenum capability, bool enabled);
+      Uniform* uniformSlot(GLint location);
+      void validateUniform(GLint location, const glm::vec4& value,
+                           bool integer) const;
+
+    private:
+      GLint  program;
+      GLint  capabilities[Capabilities];
+      GLint  blendSource;
+      GLint  blendDestination;
+      GLint  cullFaceMode;
+      GLint  depthFunction;
+      GLint  activeUnit; // Index from GL_TEXTURE0
+      GLint  textures[TextureUnits];
+      GLint  arrayBuffer;
+      GLint  elementBuffer;
+      GLint  vertexArray;
+      bool   validation;
+      Stats  stats;
+
+      Uniform attributes[Attributes]; // Constant vertex attributes
+
+      std::unordered_map<GLuint, std::vector<Uniform>> uniforms;
+      std::vector<Uniform>* programUniforms; // Of the current program
+    };
+
+    StateCache& State(void) noexcept;
+
+  } // gl
+} // Soleil
+
+#endif /* SOLEIL__STATECACHE_HPP_ */
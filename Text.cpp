@@ -22,14 +22,11 @@
 #include "Text.hpp"
 
 #include "AssetService.hpp"
+#include "Font.hpp"
 #include "OpenGLDataInstance.hpp"
+#include "StateCache.hpp"
 
-#define STB_RECT_PACK_IMPLEMENTATION
-#define STBRP_LARGE_RECTS
-#include "stb_rect_pack.h"
-
-#define STB_TRUETYPE_IMPLEMENTATION
-#include "stb_truetype.h"
+#include <algorithm>
 
 namespace Soleil {
   namespace Text {
@@ -47,336 +44,322 @@ namespace Soleil {
 
     GlyphSlot::~GlyphSlot() {}
 
-    class CharBitmap
+    void GlyphTable::insert(const wchar_t codePoint, const GlyphSlot& slot)
     {
-    public:
-      CharBitmap(const stbtt_fontinfo* font, float scaleX, float scaleY,
-                 int codePoint)
-        : scaleX(scaleX)
-        , scaleY(scaleY)
-        , codePoint(codePoint)
-      {
-        buffer = stbtt_GetCodepointBitmap(font, scaleX, scaleY, codePoint,
-                                          &width, &height, &xoffset, &yoffset);
-
-        int advanceWidth;
-        int leftSideBearing;
-
-        int x0, x1, y0, y1;
-        int lsb, iadvance;
-
-        stbtt_GetCodepointHMetrics(font, codePoint, &advanceWidth,
-                                   &leftSideBearing);
-        stbtt_GetCodepointBox(font, codePoint, &x0, &y0, &x1, &y1);
-        stbtt_GetCodepointHMetrics(font, codePoint, &iadvance, &lsb);
-        int viewport[4];
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        SOLEIL__LOGGER_DEBUG(
-          toString("Viewport: ", viewport[2], ", ", viewport[3]));
-
-        // const glm::vec2& viewport = OpenGLDataInstance::Instance().viewport;
-        const float sx = 2.0f / viewport[2];
-        const float sy = 2.0f / viewport[3];
-        pointMin.x     = (float)x0 * scaleY * sx;
-        pointMin.y     = (float)y0 * scaleY * sy;
-        pointMax.x     = (float)x1 * scaleY * sx - pointMin.x;
-        pointMax.y     = (float)y1 * scaleY * sy - pointMin.y;
-        advance        = (float)iadvance * scaleY * sx;
-      }
+      if (find(codePoint)) throw std::runtime_error("Glyph inserted twice");
 
-      virtual ~CharBitmap()
-      {
-        if (buffer) stbtt_FreeBitmap(buffer, nullptr);
+      slots.push_back(slot);
+      const std::uint16_t index = slots.size();
+      if ((std::uint32_t)codePoint < DenseCodePoints) {
+        dense[codePoint] = index;
+        return;
       }
 
-#if 1
-      CharBitmap(const CharBitmap&) = delete;
-      CharBitmap& operator=(const CharBitmap&) = delete;
-      CharBitmap(CharBitmap&& other)
-        : scaleX(other.scaleX)
-        , scaleY(other.scaleY)
-        , codePoint(other.codePoint)
-        , buffer(other.buffer)
-      {
-        other.buffer = nullptr;
-      }
-#else
-      CharBitmap()
-        : scaleX(0)
-        , scaleY(0)
-        , codePoint(0)
-        , buffer(nullptr)
-      {
+      const auto position = std::lower_bound(
+        sparse.begin(), sparse.end(), std::make_pair(codePoint, index));
+      sparse.insert(position, std::make_pair(codePoint, index));
+    }
+
+    const GlyphSlot* GlyphTable::findSparse(const wchar_t codePoint) const
+      noexcept
+    {
+      const auto it = std::lower_bound(
+        sparse.begin(), sparse.end(), codePoint,
+        [](const std::pair<wchar_t, std::uint16_t>& entry,
+           const wchar_t c) { return entry.first < c; });
+      if (it == sparse.end() || it->first != codePoint) return nullptr;
+      return &slots[it->second - 1];
+    }
+
+    void GlyphTable::throwMissing(const wchar_t codePoint)
+    {
+      throw std::runtime_error(toString(
+        "cannot find char: ", WstringToString(std::wstring({codePoint}))));
+    }
+
+    // Pixel size of the texts at 1 em, the one they were tuned for
+    static const int LayoutFontSize = 64;
+
+    /**
+     * Read the font baked by fontBaker next to the TrueType font, or bake it
+     * now if it is missing or was baked for other characters.
+     */
+    static BakedFont LoadBakedFont(const std::wstring& charMap,
+                                   const std::string&  assetFont)
+    {
+      const std::uint64_t hash =
+        BakedFont::Hash(charMap, GameFontSize, GameFontDistanceRange);
+      const std::string   atlasAsset =
+        assetFont.substr(0, assetFont.rfind('.')) + ".atlas";
+
+      BakedFont font;
+      try {
+        if (BakedFont::Deserialize(AssetService::LoadAsDataVector(atlasAsset),
+                                   hash, font))
+          return font;
+        Logger::warning(
+          toString("Outdated font atlas '", atlasAsset, "', baking it"));
+      } catch (const std::runtime_error&) {
+        // Shipped in media/, only missing from a stripped asset directory
+        Logger::warning(toString("No '", atlasAsset, "', baking it"));
       }
-#endif
-
-    public:
-      float scaleX;
-      float scaleY;
-      int   codePoint;
-
-    public:
-      unsigned char* buffer;
-      int            width;
-      int            height;
-      int            xoffset;
-      int            yoffset;
-
-    public:
-      glm::vec2 pointMin;
-      glm::vec2 pointMax;
-      float     advance;
-    };
+      return BakedFont::Bake(charMap,
+                             AssetService::LoadAsDataVector(assetFont),
+                             GameFontSize, GameFontDistanceRange, 1024, 1024);
+    }
 
     FontAtlas InitializeAtlasMap(const std::wstring& charMap,
                                  const std::string& assetFont, GLuint texture)
     {
-      std::vector<uint8_t> ttf = AssetService::LoadAsDataVector(assetFont);
-      const unsigned char* ttfBuffer = ttf.data();
-
-      stbtt_fontinfo font;
-      int            resultInitFont = stbtt_InitFont(
-        &font, ttfBuffer, stbtt_GetFontOffsetForIndex(ttfBuffer, 0));
-
-      // TODO: Throw exception
-      assert(resultInitFont && "Failed to init the font");
-
-      int                     fontSize      = 64;   // TODO: in parameter
-      int                     textureWidth  = 1024; // TODO: in parameter
-      int                     textureHeight = 1024; // TODO: in parameter
-      std::vector<CharBitmap> bitmaps;
-      bitmaps.reserve(charMap.size());
-      std::vector<stbrp_rect> rects;
-      int                     id = 0;
-
-      float scale = stbtt_ScaleForPixelHeight(&font, fontSize);
-      int   ascent;
-      int   descent;
-      int   lineGap;
-      stbtt_GetFontVMetrics(&font, &ascent, &descent, &lineGap);
-      float baseline = (int)(ascent * scale);
-
-      for (wchar_t c : charMap) {
-        bitmaps.emplace_back(&font, 0, scale, c);
-        const CharBitmap& bmp = bitmaps.back();
-        rects.push_back({id, bmp.width, bmp.height, 0, 0, 0});
-        id++;
-      }
-
-      stbrp_context           context;
-      std::vector<stbrp_node> nodes(textureWidth * textureHeight);
-      stbrp_init_target(&context, textureWidth, textureHeight, nodes.data(),
-                        nodes.size());
-      int allPacked = stbrp_pack_rects(&context, rects.data(), rects.size());
-
-      // This is not clear yet if this function will be used by game designers
-      // only to produce data that will be packed with the game, or to generate
-      // asset at start-up that cannot fails or if it can fails due to the scale
-      // size. For now just assert it worked.
-      assert(allPacked && "All chars does not fit into the atlas texture");
+      const BakedFont font = LoadBakedFont(charMap, assetFont);
 
       gl::BindTexture bindTexture(GL_TEXTURE_2D, texture);
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, textureWidth, textureHeight, 0,
-                   GL_ALPHA, GL_UNSIGNED_BYTE, nullptr);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, font.width, font.height, 0,
+                   GL_ALPHA, GL_UNSIGNED_BYTE, font.pixels.data());
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glGenerateMipmap(GL_TEXTURE_2D);
       throwOnGlError();
 
-      FontAtlas atlas;
-
+      // The metrics are baked in pixels, the text is laid out in the
+      // normalized device coordinates of the current viewport. One em is
+      // LayoutFontSize pixels whatever the size of the atlas.
       int viewport[4];
       glGetIntegerv(GL_VIEWPORT, viewport);
-      const float sx        = 2.0f / viewport[2];
-      const float sy        = 2.0f / viewport[3];
-      atlas.verticalAdvance = (ascent - descent + lineGap) * scale * sy;
-      SOLEIL__LOGGER_DEBUG(
-        toString("Vertical Advance ===>", atlas.verticalAdvance));
-
-      for (const auto& rect : rects) {
-#if 0
-      for (int j = 0; j < bmp.height; ++j) {
-        for (int i = 0; i < bmp.width; ++i)
-          putchar(" .:ovum@"[bmp.buffer[j * bmp.width + i] >> 5]);
-        putchar('\n');
-      }
-#endif
-
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h,
-                        GL_ALPHA, GL_UNSIGNED_BYTE, bitmaps[rect.id].buffer);
-
-        glm::vec2 uvOffset((float)rect.x / (float)textureWidth,
-                           (float)rect.y / (float)textureHeight);
-        glm::vec2 uvSize((float)rect.w / (float)textureWidth,
-                         (float)rect.h / (float)textureHeight);
+      const float unit = (float)LayoutFontSize / (float)font.fontSize;
+      const float sx   = 2.0f * unit / viewport[2];
+      const float sy   = 2.0f * unit / viewport[3];
 
-        const auto& g = bitmaps[rect.id];
-        atlas.glyphs.emplace(
+      FontAtlas atlas;
+      atlas.verticalAdvance = font.verticalAdvance * sy;
+      atlas.distanceRange   = font.distanceRange;
+      atlas.pixelsPerTexel  = unit;
+      for (const BakedFont::Glyph& g : font.glyphs) {
+        const glm::vec2 uvOffset((float)g.x / (float)font.width,
+                                 (float)g.y / (float)font.height);
+        const glm::vec2 uvSize((float)g.width / (float)font.width,
+                               (float)g.height / (float)font.height);
+        const glm::vec2 pointMin(g.minX * sx, g.minY * sy);
+        const glm::vec2 pointMax((g.maxX - g.minX) * sx,
+                                 (g.maxY - g.minY) * sy);
+
+        atlas.glyphs.insert(
           g.codePoint,
-          GlyphSlot(uvOffset, uvSize, g.pointMin, g.pointMax, g.advance));
+          GlyphSlot(uvOffset, uvSize, pointMin, pointMax, g.advance * sx));
       }
-      throwOnGlError();
+      SOLEIL__LOGGER_DEBUG(toString("Font atlas of ", atlas.glyphs.size(),
+                                    " glyphs, viewport: ", viewport[2], ", ",
+                                    viewport[3]));
 
       return atlas;
     }
 
-    void FillBuffer(const std::wstring& text, TextCommand& textCommand,
-                    const FontAtlas& atlas, float em, BoundingBox* bounds)
+    /**
+     * Append the quad of the glyph drawn from the pen at offset
+     */
+    static inline void PushQuad(const GlyphSlot& g, const glm::vec2& offset,
+                                const float              em,
+                                std::vector<CharVertex>& vertices)
     {
-      int                     elemId = 0;
-      glm::vec2               offset(0.0f);
-      std::vector<CharVertex> vertices;
+      const glm::vec2 uvOffset = g.uvOffset;
+      const glm::vec2 uvSize(uvOffset.x + g.uvSize.x, uvOffset.y + g.uvSize.y);
+      const glm::vec2 size(offset.x + g.pointMin.x, offset.y + g.pointMin.y);
+
+      vertices.push_back(
+        {glm::vec3(offset.x + g.pointMin.x, offset.y + g.pointMin.y, 0.0f) * em,
+         glm::vec2(uvOffset.x, uvSize.y)});
+      vertices.push_back(
+        {glm::vec3(size.x + g.pointMax.x, offset.y + g.pointMin.y, 0.0f) * em,
+         glm::vec2(uvSize.x, uvSize.y)});
+      vertices.push_back(
+        {glm::vec3(size.x + g.pointMax.x, size.y + g.pointMax.y, 0.0f) * em,
+         glm::vec2(uvSize.x, uvOffset.y)});
+      vertices.push_back(
+        {glm::vec3(offset.x + g.pointMin.x, size.y + g.pointMax.y, 0.0f) * em,
+         glm::vec2(uvOffset.x, uvOffset.y)});
+    }
 
-      textCommand.elements.clear();
+    void LayoutText(const std::wstring& text, const FontAtlas& atlas, float em,
+                    std::vector<CharVertex>& vertices)
+    {
+      glm::vec2 offset(0.0f);
 
-      for (wchar_t c : text) {
+      vertices.reserve(vertices.size() + text.size() * 4);
+      for (const wchar_t c : text) {
         if (c == '\n') {
           offset.x = 0;
           offset.y -= atlas.verticalAdvance;
           continue;
         }
 
-#ifndef NDEBUG
-        if (atlas.glyphs.find(c) == atlas.glyphs.end())
-          throw std::runtime_error(
-            toString("cannot find char: ", WstringToString(std::wstring({c}))));
-#endif
-        const GlyphSlot& g        = atlas.glyphs.at(c);
-        const glm::vec2  uvOffset = g.uvOffset;
-        const glm::vec2  uvSize(uvOffset.x + g.uvSize.x,
-                               uvOffset.y + g.uvSize.y);
-        const glm::vec2 size(offset.x + g.pointMin.x, offset.y + g.pointMin.y);
-
-        vertices.push_back(
-          {glm::vec3(offset.x + g.pointMin.x, offset.y + g.pointMin.y, 0.0f) *
-             em,
-           glm::vec2(uvOffset.x, uvSize.y)});
-        vertices.push_back(
-          {glm::vec3(size.x + g.pointMax.x, offset.y + g.pointMin.y, 0.0f) * em,
-           glm::vec2(uvSize.x, uvSize.y)});
-        vertices.push_back(
-          {glm::vec3(size.x + g.pointMax.x, size.y + g.pointMax.y, 0.0f) * em,
-           glm::vec2(uvSize.x, uvOffset.y)});
-        vertices.push_back(
-          {glm::vec3(offset.x + g.pointMin.x, size.y + g.pointMax.y, 0.0f) * em,
-           glm::vec2(uvOffset.x, uvOffset.y)});
-
+        const GlyphSlot& g = atlas.glyphs.at(c);
+        PushQuad(g, offset, em, vertices);
         offset.x += g.advance;
-
-        textCommand.elements.push_back(0 + elemId);
-        textCommand.elements.push_back(1 + elemId);
-        textCommand.elements.push_back(2 + elemId);
-        textCommand.elements.push_back(2 + elemId);
-        textCommand.elements.push_back(3 + elemId);
-        textCommand.elements.push_back(0 + elemId);
-        elemId += 4;
       }
-
-      if (bounds) {
-        for (const auto& v : vertices) {
-          bounds->expandBy(v.position);
-        }
-      }
-
-      glBindBuffer(GL_ARRAY_BUFFER, *textCommand.buffer);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(),
-                   vertices.data(), GL_DYNAMIC_DRAW);
-
-      throwOnGlError();
     }
 
-    void FillBufferWithDimensions(const std::wstring& text,
-                                  TextCommand&        textCommand,
-                                  const FontAtlas& atlas, float em,
-                                  const glm::vec2& dimensions)
+    void LayoutWrappedText(const std::wstring& text, const FontAtlas& atlas,
+                           float em, float width,
+                           std::vector<CharVertex>&  vertices,
+                           std::vector<LineMetrics>* lines)
     {
-      int                     elemId = 0;
-      glm::vec2               offset(0.0f);
-      std::vector<CharVertex> vertices;
-
-      textCommand.elements.clear();
-      std::wstring::const_iterator lastBreak    = text.begin();
-      auto                         charToUnwind = vertices.end();
-
-      for (auto it = text.begin(); it != text.end(); ++it) {
-        wchar_t c = *it;
-
+      struct Line
+      {
+        std::size_t first;
+        std::size_t last;  // Excluded
+        float       width; // Up to the advance of its last non-space glyph
+      };
+
+      // Break, measuring each glyph once: a glyph whose left side crosses
+      // the width starts a new line, after the last space of the line, or
+      // with it if the line has none. The space at the break is dropped.
+      // The pen runs from the start of the text, so the glyphs after the
+      // space are not measured again.
+      const std::size_t count     = text.size();
+      std::size_t       first     = 0;
+      std::size_t       lastSpace = count; // None in the line
+      float             pen       = 0.0f;
+      float             lineStart = 0.0f; // Pen at the first glyph
+      float             lineEnd   = 0.0f; // After the last non-space glyph
+      float             spaceEnd  = 0.0f; // lineEnd at the last space
+      float             afterSpace = 0.0f;
+      std::vector<Line> breaks;
+
+      for (std::size_t i = 0; i < count; ++i) {
+        const wchar_t c = text[i];
         if (c == L'\n') {
-          offset.x = 0;
-          offset.y -= atlas.verticalAdvance;
-
-          lastBreak    = it;
-          charToUnwind = vertices.end();
+          breaks.push_back({first, i, lineEnd - lineStart});
+          first     = i + 1;
+          lastSpace = count;
+          lineStart = lineEnd = pen;
           continue;
-        } else if (c == L' ') {
-          lastBreak    = it;
-          charToUnwind = vertices.end();
         }
 
-#ifndef NDEBUG
-        if (atlas.glyphs.find(c) == atlas.glyphs.end())
-          throw std::runtime_error(
-            toString("cannot find char: ", WstringToString(std::wstring({c}))));
-#endif
-        const GlyphSlot& g        = atlas.glyphs.at(c);
-        const glm::vec2  uvOffset = g.uvOffset;
-        const glm::vec2  uvSize(uvOffset.x + g.uvSize.x,
-                               uvOffset.y + g.uvSize.y);
-        // TODO: Add a current offset with these value and add point max to size
-        glm::vec2 size(offset.x + g.pointMin.x, offset.y + g.pointMin.y);
-
-        if (size.x > dimensions.x) {
-          offset.x = 0;
-          offset.y -= atlas.verticalAdvance;
-
-          if (lastBreak != text.begin()) {
-            // Unwind till last space
-            vertices.erase(charToUnwind, vertices.end());
+        const GlyphSlot& g = atlas.glyphs.at(c);
+        if (c == L' ') {
+          lastSpace  = i;
+          spaceEnd   = lineEnd;
+          afterSpace = pen + g.advance;
+        }
 
-            // return to previous space
-            it = lastBreak;
+        const float left = pen + g.pointMin.x;
+        if (left - lineStart > width && i > first) {
+          if (lastSpace != count && lastSpace > first) {
+            breaks.push_back({first, lastSpace, spaceEnd - lineStart});
+            first     = lastSpace + 1;
+            lastSpace = count;
+            lineStart = afterSpace;
+          }
+          // Still too long, a word larger than the line
+          if (left - lineStart > width && i > first) {
+            breaks.push_back({first, i, lineEnd - lineStart});
+            first     = i;
+            lineStart = pen;
+          }
+        }
 
-            // Avoid infinite loop if the word is too large
-            lastBreak = text.begin();
+        pen += g.advance;
+        if (c != L' ') lineEnd = pen;
+      }
+      breaks.push_back({first, count, lineEnd - lineStart});
+
+      // Emit each glyph once
+      vertices.reserve(vertices.size() + count * 4);
+      glm::vec2 offset(0.0f);
+      for (const Line& line : breaks) {
+        const std::size_t firstQuad = vertices.size() / 4;
+
+        offset.x = 0.0f;
+        for (std::size_t i = line.first; i < line.last; ++i) {
+          const GlyphSlot& g = atlas.glyphs.at(text[i]);
+          PushQuad(g, offset, em, vertices);
+          offset.x += g.advance;
+        }
 
-            continue;
-          } else {
-            // TODO: Same as above: put it in a function
-            size = glm::vec2(offset.x + g.pointMin.x, offset.y + g.pointMin.y);
-          }
+        if (lines) {
+          lines->push_back({firstQuad, vertices.size() / 4 - firstQuad,
+                            std::max(line.width, 0.0f) * em, offset.y * em});
         }
+        offset.y -= atlas.verticalAdvance;
+      }
+    }
 
-        vertices.push_back(
-          {glm::vec3(offset.x + g.pointMin.x, offset.y + g.pointMin.y, 0.0f) *
-             em,
-           glm::vec2(uvOffset.x, uvSize.y)});
-        vertices.push_back(
-          {glm::vec3(size.x + g.pointMax.x, offset.y + g.pointMin.y, 0.0f) * em,
-           glm::vec2(uvSize.x, uvSize.y)});
-        vertices.push_back(
-          {glm::vec3(size.x + g.pointMax.x, size.y + g.pointMax.y, 0.0f) * em,
-           glm::vec2(uvSize.x, uvOffset.y)});
-        vertices.push_back(
-          {glm::vec3(offset.x + g.pointMin.x, size.y + g.pointMax.y, 0.0f) * em,
-           glm::vec2(uvOffset.x, uvOffset.y)});
+    bool LayoutCache::Key::operator==(const Key& other) const noexcept
+    {
+      return atlas == other.atlas && em == other.em && width == other.width &&
+             text == other.text;
+    }
 
-        offset.x += g.advance;
+    std::size_t LayoutCache::KeyHash::operator()(const Key& key) const noexcept
+    {
+      const auto combine = [](std::size_t hash, const std::size_t value) {
+        return hash ^ (value + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+      };
+
+      std::size_t hash = std::hash<std::wstring>()(key.text);
+      hash = combine(hash, std::hash<const FontAtlas*>()(key.atlas));
+      hash = combine(hash, std::hash<float>()(key.em));
+      return combine(hash, std::hash<float>()(key.width));
+    }
 
-        textCommand.elements.push_back(0 + elemId);
-        textCommand.elements.push_back(1 + elemId);
-        textCommand.elements.push_back(2 + elemId);
-        textCommand.elements.push_back(2 + elemId);
-        textCommand.elements.push_back(3 + elemId);
-        textCommand.elements.push_back(0 + elemId);
-        elemId += 4;
+    TextQuads LayoutCache::get(const std::wstring& text,
+                               const FontAtlas& atlas, const float em,
+                               const float width)
+    {
+      Key  key   = {text, &atlas, em, width};
+      auto found = entries.find(key);
+      clock++;
+      if (found != entries.end()) {
+        stats.hits++;
+        found->second.lastUse = clock;
+        return found->second.quads;
       }
 
-      glBindBuffer(GL_ARRAY_BUFFER, *textCommand.buffer);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(),
-                   vertices.data(), GL_DYNAMIC_DRAW);
+      stats.misses++;
+      auto vertices = std::make_shared<std::vector<CharVertex>>();
+      if (width > 0.0f)
+        LayoutWrappedText(text, atlas, em, width, *vertices);
+      else
+        LayoutText(text, atlas, em, *vertices);
+
+      if (entries.size() >= Capacity) {
+        typedef std::pair<const Key, Entry> Cached;
+        const auto oldest = std::min_element(
+          entries.begin(), entries.end(), [](const Cached& a, const Cached& b) {
+            return a.second.lastUse < b.second.lastUse;
+          });
+        entries.erase(oldest);
+      }
 
-      throwOnGlError();
+      TextQuads quads = std::move(vertices);
+      entries.emplace(std::move(key), Entry{quads, clock});
+      return quads;
+    }
+
+    void FillBuffer(const std::wstring& text, TextCommand& textCommand,
+                    const FontAtlas& atlas, float em, BoundingBox* bounds)
+    {
+      textCommand.quads = OpenGLDataInstance::Instance().textLayouts.get(
+        text, atlas, em, 0.0f);
+      textCommand.em               = em;
+      textCommand.streamGeneration = 0;
+
+      if (bounds) {
+        for (const auto& v : *textCommand.quads) {
+          bounds->expandBy(v.position);
+        }
+      }
+    }
+
+    void FillBufferWithDimensions(const std::wstring& text,
+                                  TextCommand&        textCommand,
+                                  const FontAtlas& atlas, float em,
+                                  const glm::vec2& dimensions)
+    {
+      textCommand.quads = OpenGLDataInstance::Instance().textLayouts.get(
+        text, atlas, em, dimensions.x);
+      textCommand.em               = em;
+      textCommand.streamGeneration = 0;
     }
 
   } // Text
@@ -24,10 +24,12 @@
 
 #include "Draw.hpp"
 #include "OpenGLInclude.hpp"
-#include "stb_truetype.h"
 
-#include <map>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glm/vec2.hpp>
 
@@ -49,14 +51,138 @@ namespace Soleil {
       ~GlyphSlot(void);
     };
 
+    /**
+     * Glyphs of a font by code point: a dense table for the Latin-1 ones and a
+     * table sorted by code point for the others.
+     */
+    class GlyphTable
+    {
+    public:
+      static const std::uint32_t DenseCodePoints = 256;
+
+    public:
+      void insert(const wchar_t codePoint, const GlyphSlot& slot);
+
+      /**
+       * Return nullptr if the font does not have the glyph
+       */
+      inline const GlyphSlot* find(const wchar_t codePoint) const noexcept
+      {
+        if ((std::uint32_t)codePoint < DenseCodePoints) {
+          const std::uint16_t index = dense[codePoint];
+          return (index == 0) ? nullptr : &slots[index - 1];
+        }
+        return findSparse(codePoint);
+      }
+
+      /**
+       * Throw if the font does not have the glyph
+       */
+      inline const GlyphSlot& at(const wchar_t codePoint) const
+      {
+        const GlyphSlot* slot = find(codePoint);
+        if (slot == nullptr) throwMissing(codePoint);
+        return *slot;
+      }
+
+      std::size_t size(void) const noexcept { return slots.size(); }
+
+    private:
+      const GlyphSlot* findSparse(const wchar_t codePoint) const noexcept;
+      [[noreturn]] static void throwMissing(const wchar_t codePoint);
+
+    private:
+      std::vector<GlyphSlot> slots;
+      // Index in slots + 1, 0 for no glyph
+      std::uint16_t dense[DenseCodePoints] = {};
+      std::vector<std::pair<wchar_t, std::uint16_t>> sparse;
+    };
+
     struct FontAtlas
     {
-      std::map<wchar_t, GlyphSlot> glyphs;
+      GlyphTable glyphs;
       float verticalAdvance;
+      float distanceRange;  // In texels, 0 if the atlas holds the coverage
+      float pixelsPerTexel; // Screen pixels of one texel of a text at 1 em
     };
 
     FontAtlas InitializeAtlasMap(const std::wstring& charMap,
                                  const std::string& assetFont, GLuint texture);
+    /**
+     * Line of a wrapped text, in the coordinates of its vertices
+     */
+    struct LineMetrics
+    {
+      std::size_t firstQuad;
+      std::size_t quads;
+      float       width;    // Up to the advance of its last non-space glyph
+      float       baseline; // y of the pen
+    };
+
+    /**
+     * Lay the text out in quads from the pen at (0, 0), appending their
+     * vertices. The wrapped text goes to the next line before the word that
+     * would cross the width (before em), in time linear in its length.
+     */
+    void LayoutText(const std::wstring& text, const FontAtlas& atlas, float em,
+                    std::vector<CharVertex>& vertices);
+    void LayoutWrappedText(const std::wstring& text, const FontAtlas& atlas,
+                           float em, float width,
+                           std::vector<CharVertex>&  vertices,
+                           std::vector<LineMetrics>* lines = nullptr);
+
+    /**
+     * Texts laid out recently, by content, atlas, size and wrapping width, so
+     * the labels filled again with the same text share their quads. Past
+     * Capacity, the least recently used one is dropped.
+     */
+    class LayoutCache
+    {
+    public:
+      static const std::size_t Capacity = 32;
+
+      struct Stats
+      {
+        std::size_t hits   = 0;
+        std::size_t misses = 0;
+      };
+
+    public:
+      /**
+       * Lay the text out unless cached. A width of 0 does not wrap it.
+       */
+      TextQuads get(const std::wstring& text, const FontAtlas& atlas,
+                    const float em, const float width);
+
+      const Stats& getStats(void) const noexcept { return stats; }
+
+    private:
+      struct Key
+      {
+        std::wstring     text;
+        const FontAtlas* atlas;
+        float            em;
+        float            width;
+
+        bool operator==(const Key& other) const noexcept;
+      };
+
+      struct KeyHash
+      {
+        std::size_t operator()(const Key& key) const noexcept;
+      };
+
+      struct Entry
+      {
+        TextQuads     quads;
+        std::uint64_t lastUse;
+      };
+
+    private:
+      std::unordered_map<Key, Entry, KeyHash> entries;
+      std::uint64_t                           clock = 0;
+      Stats                                   stats;
+    };
     void FillBuffer(const std::wstring& text, TextCommand& textCommand,
                     const FontAtlas& atlas, float em,
                     BoundingBox* bounds = nullptr);
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "TextureCache.hpp"
+
+#include "StateCache.hpp"
+
+#include <algorithm>
+
+namespace Soleil {
+
+  TexturePtr TextureCache::get(const std::string& assetName,
+                               const Upload&      upload)
+  {
+    std::weak_ptr<const gl::Texture>& entry = textures[assetName];
+
+    TexturePtr texture = entry.lock();
+    if (texture) {
+      stats.hits++;
+      return texture;
+    }
+
+    auto created = std::make_shared<gl::Texture>();
+    gl::State().bindTexture(GL_TEXTURE_2D, **created);
+    upload(assetName);
+    throwOnGlError();
+
+    stats.misses++;
+    entry = created;
+    return created;
+  }
+
+  std::size_t TextureCache::resident(void) const noexcept
+  {
+    return std::count_if(
+      textures.begin(), textures.end(),
+      [](const std::pair<const std::string, std::weak_ptr<const gl::Texture>>&
+           entry) { return entry.second.expired() == false; });
+  }
+
+} // Soleil
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SOLEIL__TEXTURECACHE_HPP_
+#define SOLEIL__TEXTURECACHE_HPP_
+
+#include "OpenGLInclude.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Soleil {
+
+  /**
+   * Shared ownership of a texture: it is deleted with its last handle.
+   */
+  typedef std::shared_ptr<const gl::Texture> TexturePtr;
+
+  /**
+   * Textures loaded from the assets, by asset name. A texture is uploaded
+   * once and shared as long as a handle on it is alive: the materials of
+   * several models, or the same model loaded again, reuse it.
+   */
+  class TextureCache
+  {
+  public:
+    /**
+     * Fill the bound GL_TEXTURE_2D from the asset
+     */
+    typedef std::function<void(const std::string& assetName)> Upload;
+
+    struct Stats
+    {
+      std::size_t hits   = 0; // Requests served by a live texture
+      std::size_t misses = 0; // Requests that uploaded the texture
+    };
+
+  public:
+    /**
+     * Return the texture of the asset, uploading it on a miss.
+     */
+    TexturePtr get(const std::string& assetName, const Upload& upload);
+
+    /**
+     * Number of textures still in use
+     */
+    std::size_t  resident(void) const noexcept;
+    const Stats& getStats(void) const noexcept { return stats; }
+
+  private:
+    std::unordered_map<std::string, std::weak_ptr<const gl::Texture>> textures;
+    Stats stats;
+  };
+
+} // Soleil
+
+#endif /* SOLEIL__TEXTURECACHE_HPP_ */
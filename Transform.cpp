@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "Transform.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SOLEIL__TRANSFORM_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SOLEIL__TRANSFORM_NEON
+#endif
+
+namespace Soleil {
+
+  void MultiplyMatrices(const glm::mat4& left, const glm::mat4* right,
+                        glm::mat4* out, const std::size_t count) noexcept
+  {
+    // Each column of the product is the columns of left weighted by the
+    // components of the column of right.
+    const float* l = glm::value_ptr(left);
+
+#if defined(SOLEIL__TRANSFORM_SSE)
+    const __m128 c0 = _mm_loadu_ps(l);
+    const __m128 c1 = _mm_loadu_ps(l + 4);
+    const __m128 c2 = _mm_loadu_ps(l + 8);
+    const __m128 c3 = _mm_loadu_ps(l + 12);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      const float* r = glm::value_ptr(right[i]);
+      float*       o = glm::value_ptr(out[i]);
+
+      for (int column = 0; column < 16; column += 4) {
+        __m128 v = _mm_mul_ps(c0, _mm_set1_ps(r[column]));
+        v        = _mm_add_ps(v, _mm_mul_ps(c1, _mm_set1_ps(r[column + 1])));
+        v        = _mm_add_ps(v, _mm_mul_ps(c2, _mm_set1_ps(r[column + 2])));
+        v        = _mm_add_ps(v, _mm_mul_ps(c3, _mm_set1_ps(r[column + 3])));
+        _mm_storeu_ps(o + column, v);
+      }
+    }
+#elif defined(SOLEIL__TRANSFORM_NEON)
+    const float32x4_t c0 = vld1q_f32(l);
+    const float32x4_t c1 = vld1q_f32(l + 4);
+    const float32x4_t c2 = vld1q_f32(l + 8);
+    const float32x4_t c3 = vld1q_f32(l + 12);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      const float* r = glm::value_ptr(right[i]);
+      float*       o = glm::value_ptr(out[i]);
+
+      for (int column = 0; column < 16; column += 4) {
+        float32x4_t v = vmulq_n_f32(c0, r[column]);
+        v             = vmlaq_n_f32(v, c1, r[column + 1]);
+        v             = vmlaq_n_f32(v, c2, r[column + 2]);
+        v             = vmlaq_n_f32(v, c3, r[column + 3]);
+        vst1q_f32(o + column, v);
+      }
+    }
+#else
+    (void)l;
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = left * right[i];
+    }
+#endif
+  }
+
+  glm::mat3 NormalMatrix(const glm::mat4& model) noexcept
+  {
+    // The columns of the inverse transpose are the cross products of the
+    // other two columns, over the determinant.
+    const glm::vec3 x(model[0]);
+    const glm::vec3 y(model[1]);
+    const glm::vec3 z(model[2]);
+    const glm::vec3 yz = glm::cross(y, z);
+
+    const float inverseDeterminant = 1.0f / glm::dot(x, yz);
+    return glm::mat3(yz * inverseDeterminant,
+                     glm::cross(z, x) * inverseDeterminant,
+                     glm::cross(x, y) * inverseDeterminant);
+  }
+
+} // Soleil
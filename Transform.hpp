@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef SOLEIL__TRANSFORM_HPP_
+#define SOLEIL__TRANSFORM_HPP_
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <cstddef>
+
+namespace Soleil {
+
+  /**
+   * out[i] = left * right[i] for the count matrices, four columns at once with
+   * SSE or NEON when the target has them. out must not overlap right.
+   */
+  void MultiplyMatrices(const glm::mat4& left, const glm::mat4* right,
+                        glm::mat4* out, const std::size_t count) noexcept;
+
+  /**
+   * Inverse transpose of the upper 3x3 of the model matrix, transforming the
+   * normals.
+   */
+  glm::mat3 NormalMatrix(const glm::mat4& model) noexcept;
+
+} // Soleil
+
+#endif /* SOLEIL__TRANSFORM_HPP_ */
@@ -22,12 +22,18 @@
 #include "World.hpp"
 
 #include "AssetService.hpp"
+#include "LevelOptimizer.hpp"
+#include "OpenGLDataInstance.hpp"
 #include "WavefrontLoader.hpp"
 #include "stringutils.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <functional>
+#include <limits>
+#include <set>
+#include <tuple>
 
 namespace Soleil {
 
@@ -51,6 +57,14 @@ namespace Soleil {
       ghost, // The bad One
       ghost  // The Good one
     };
+
+    // The previous models are only released once the new ones are loaded,
+    // so a new game reuses all of their textures
+    const TextureCache& textures = OpenGLDataInstance::Instance().textures;
+    SOLEIL__LOGGER_DEBUG(toString("Textures: ", textures.resident(),
+                                  " in use, ", textures.getStats().misses,
+                                  " uploads, ", textures.getStats().hits,
+                                  " reused"));
   }
 
   void InitializeWorldDoors(World& world, const std::string& assetName)
@@ -112,9 +126,18 @@ namespace Soleil {
     hardSurfaces.clear();
 
     ghosts.clear();
+    staticLights.clear();
     items.clear();
     elements.clear();
     triggers.clear();
+    mergedWalls.clear();
+    bakedStatics.clear();
+    elementBounds.clear();
+    itemBounds.clear();
+    mergedWallBounds.clear();
+    bakedBounds.clear();
+    queue.clear();
+    pvs = Pvs();
   }
 
   void pushCoin(DrawElement& draw, World& world)
@@ -199,6 +222,7 @@ namespace Soleil {
     Statics,
     Coins,
     Ghosts,
+    Lights,
   };
 
   static void ReserveArrays(World& world, std::istringstream& s, Step step)
@@ -213,6 +237,7 @@ namespace Soleil {
         world.sentinels.reserve(count);
       } break;
       case Coins: world.items.reserve(numberOfElements); break;
+      case Lights: world.staticLights.reserve(numberOfElements); break;
     }
   }
 
@@ -224,6 +249,7 @@ namespace Soleil {
     world.items.clear();
     world.ghosts.clear();
     world.triggers.clear();
+    world.staticLights.clear();
     int step = Step::Statics;
     while (std::getline(s, line)) {
       if (line[0] == '#') continue; // Skip comments
@@ -235,7 +261,17 @@ namespace Soleil {
       }
 
       std::istringstream drawStr(line);
-      DrawElement        draw;
+      if (step == Step::Lights) {
+        // x y z r g b linear quadratic
+        PointLight light;
+        drawStr >> light.position.x >> light.position.y >> light.position.z >>
+          light.color.r >> light.color.g >> light.color.b >> light.linear >>
+          light.quadratic;
+        world.staticLights.push_back(light);
+        continue;
+      }
+
+      DrawElement draw;
 
       drawStr >> draw.shapeIndex;
 
@@ -246,6 +282,7 @@ namespace Soleil {
         }
       }
       draw.id = DrawElement::Hash(draw);
+      draw.updateNormalMatrix();
 
       const std::string arguments = [&drawStr]() {
         std::string value;
@@ -315,6 +352,11 @@ namespace Soleil {
                                   std::hash<std::string>{}(door.output)});
     }
 
+    if (gval::mergeWalls) MergeWalls(world);
+    if (gval::bakeStatics) BakeStatics(world);
+    ComputeBounds(world);
+    if (gval::usePvs) LoadPvs(world, start.level, level);
+
 #if 0
     // Test: Render Bézier to image
     const int width     = 800;
@@ -349,7 +391,7 @@ namespace Soleil {
         image[index] = 0xFFFF0000;
       }
     }
-    gl::Texture&    texture = OpenGLDataInstance::Instance().textures.back();
+    gl::Texture&    texture = OpenGLDataInstance::Instance().textureTest;
     gl::BindTexture bindTexture(GL_TEXTURE_2D, *texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
                  GL_UNSIGNED_BYTE, image.data());
@@ -360,6 +402,241 @@ namespace Soleil {
 #endif
   }
 
+  static glm::ivec3 FloorDivide(const glm::ivec3& a, const glm::ivec3& b)
+  {
+    glm::ivec3 result;
+    for (int i = 0; i < 3; ++i) {
+      const bool inexact  = (a[i] % b[i]) != 0;
+      const bool negative = (a[i] < 0) != (b[i] < 0);
+      result[i]           = a[i] / b[i] - ((inexact && negative) ? 1 : 0);
+    }
+    return result;
+  }
+
+  /**
+   * Replace the wall cubes laid on the grid by their visible sides, merged in
+   * larger quads. The collision boxes of the statics are merged as well.
+   */
+  void MergeWalls(World& world)
+  {
+    const std::vector<SubShape>& wall =
+      world.shapes[ShapeType::WallCube]->getSubShapes();
+    CubeModel model;
+
+    world.mergedWalls.clear();
+    if (CubeModel::FromSubShapes(wall, model) == false) {
+      SOLEIL__LOGGER_DEBUG("WallCube is not a box, walls are not merged");
+      return;
+    }
+
+    std::vector<glm::ivec3> cells;
+    glm::ivec3              cell;
+    const auto              walls = std::remove_if(
+      world.elements.begin(), world.elements.end(),
+      [&](const DrawElement& e) {
+        if (e.shapeIndex != ShapeType::WallCube ||
+            GridCell(e.transformation, model, cell) == false)
+          return false;
+
+        cells.push_back(cell);
+        return true;
+      });
+    world.elements.erase(walls, world.elements.end());
+
+    // One set of Shapes per region, so they can be culled
+    const glm::vec3  size = model.size();
+    const glm::ivec3 regionCells(
+      std::max(1, static_cast<int>(gval::bakeRegionSize / size.x)),
+      std::max(1, static_cast<int>(gval::bakeRegionSize / size.y)),
+      std::max(1, static_cast<int>(gval::bakeRegionSize / size.z)));
+    std::set<std::tuple<int, int, int>> regions;
+    for (const glm::ivec3& c : cells) {
+      const glm::ivec3 region = FloorDivide(c, regionCells);
+      regions.emplace(region.x, region.y, region.z);
+    }
+
+    for (const auto& r : regions) {
+      const glm::ivec3 from =
+        glm::ivec3(std::get<0>(r), std::get<1>(r), std::get<2>(r)) *
+        regionCells;
+      const glm::ivec3 to = from + regionCells - 1;
+
+      for (const SubShape& sub : MergeGridCubes(cells, model, wall, from, to)) {
+        world.mergedWalls.push_back(
+          std::make_shared<Shape>(std::vector<SubShape>{sub}));
+      }
+    }
+
+    const std::size_t boxes = world.hardSurfaces.size();
+    MergeBoundingBoxes(world.hardSurfaces);
+    SOLEIL__LOGGER_DEBUG(toString("Merged ", cells.size(), " walls, ", boxes,
+                                  " collision boxes into ",
+                                  world.hardSurfaces.size()));
+  }
+
+  /**
+   * Region of the level holding the position, see gval::bakeRegionSize
+   */
+  static glm::ivec3 BakeRegion(const glm::vec3& position)
+  {
+    return glm::ivec3(glm::floor(position / gval::bakeRegionSize));
+  }
+
+  /**
+   * Merge all the statics of the level in world space, one Shape per material
+   * and region of the level.
+   *
+   * The statics never move once loaded, so instead of drawing each of them
+   * from its own model, they are drawn in a few calls. Keeping the regions
+   * apart lets the renderer cull them. A batch is split in several Shapes if
+   * its vertices cannot be addressed by GLushort indices.
+   *
+   * The ambient light and the static lights are baked in the vertex colors,
+   * the shaders only add the camera and ghost lights.
+   */
+  void BakeStatics(World& world)
+  {
+    constexpr std::size_t maxVertices = std::numeric_limits<GLushort>::max() + 1;
+    std::vector<SubShape>   batches;
+    std::vector<glm::ivec3> batchRegions;
+
+    const auto bake = [&](const SubShape& sub, const glm::mat4& transformation,
+                          const glm::ivec3& region) {
+      const glm::mat3 normalMatrix =
+        glm::transpose(glm::inverse(glm::mat3(transformation)));
+
+      // Only the last batch of a material may still have room left
+      std::size_t batch = batches.size();
+      while (batch > 0 && (batches[batch - 1].material != sub.material ||
+                           batchRegions[batch - 1] != region))
+        --batch;
+      if (batch == 0 ||
+          batches[batch - 1].vertices.size() + sub.vertices.size() >
+            maxVertices) {
+        batches.emplace_back();
+        batches.back().material = sub.material;
+        batchRegions.push_back(region);
+        batch = batches.size();
+      }
+      SubShape& target = batches[batch - 1];
+
+      const std::size_t base = target.vertices.size();
+      for (const Vertex& v : sub.vertices) {
+        target.vertices.emplace_back(transformation * v.position,
+                                     glm::normalize(normalMatrix * v.normal),
+                                     v.color, v.uv);
+      }
+      for (GLushort index : sub.indices) {
+        target.indices.push_back(static_cast<GLushort>(base + index));
+      }
+    };
+
+    world.bakedStatics.clear();
+    for (const DrawElement& e : world.elements) {
+      const glm::ivec3 region = BakeRegion(glm::vec3(e.transformation[3]));
+
+      for (const SubShape& sub : world.shapes[e.shapeIndex]->getSubShapes()) {
+        bake(sub, e.transformation, region);
+      }
+    }
+    for (const ShapePtr& shape : world.mergedWalls) {
+      const BoundingBox box = shape->makeBoundingBox();
+      const glm::ivec3  region =
+        BakeRegion((box.getMin() + box.getMax()) / 2.0f);
+
+      for (const SubShape& sub : shape->getSubShapes()) {
+        bake(sub, glm::mat4(), region);
+      }
+    }
+
+    for (SubShape& batch : batches) {
+      BakeLighting(batch, gval::ambiantLight, world.staticLights);
+      world.bakedStatics.push_back(
+        std::make_shared<Shape>(std::vector<SubShape>{batch}));
+    }
+    SOLEIL__LOGGER_DEBUG(toString("Baked ", world.elements.size(),
+                                  " statics into ", batches.size(),
+                                  " buffers, lit by ",
+                                  world.staticLights.size(), " static lights"));
+  }
+
+  /**
+   * Fill the world space bounds of the drawn elements once for the level.
+   */
+  void ComputeBounds(World& world)
+  {
+    std::vector<BoundingBox> models;
+    for (const ShapePtr& shape : world.shapes) {
+      models.push_back(shape->makeBoundingBox());
+    }
+
+    const auto fill = [&models](BoxArray&                       bounds,
+                                const std::vector<DrawElement>& elements) {
+      bounds.clear();
+      for (const DrawElement& e : elements) {
+        BoundingBox box = models[e.shapeIndex];
+        box.transform(e.transformation);
+        bounds.push(box);
+      }
+    };
+    fill(world.elementBounds, world.elements);
+    fill(world.itemBounds, world.items);
+
+    world.mergedWallBounds.clear();
+    for (const ShapePtr& shape : world.mergedWalls) {
+      world.mergedWallBounds.push(shape->makeBoundingBox());
+    }
+    world.bakedBounds.clear();
+    for (const ShapePtr& shape : world.bakedStatics) {
+      world.bakedBounds.push(shape->makeBoundingBox());
+    }
+  }
+
+  /**
+   * Set the PVS of the level: from the sets of the levels already visited,
+   * then from the <level>.pvs asset baked by pvsBaker, computed otherwise.
+   */
+  void LoadPvs(World& world, const std::string& levelAsset,
+               const std::string& level)
+  {
+    const auto cached = world.pvsCache.find(levelAsset);
+    if (cached != world.pvsCache.end()) {
+      world.pvs = cached->second;
+      return;
+    }
+
+    const std::string pvsAsset =
+      levelAsset.substr(0, levelAsset.rfind('.')) + ".pvs";
+    bool loaded = false;
+    try {
+      loaded = Pvs::Deserialize(AssetService::LoadAsString(pvsAsset),
+                                Pvs::Hash(level), world.pvs);
+    } catch (const std::runtime_error&) {
+      // The baked set is optional
+    }
+
+    if (loaded == false) {
+      SOLEIL__LOGGER_DEBUG(toString("Computing the PVS of ", levelAsset));
+      world.pvs =
+        Pvs::FromLevel(level, gval::pvsCellSize, gval::pvsMaxDistance);
+    }
+    world.pvsCache[levelAsset] = world.pvs;
+  }
+
+  /**
+   * Remove a picked up item, and its bounds.
+   */
+  void RemoveItem(World& world, const std::size_t id)
+  {
+    for (std::size_t i = 0; i < world.items.size(); ++i) {
+      if (world.items[i].id == id) {
+        world.items.erase(world.items.begin() + i);
+        world.itemBounds.erase(i);
+        return;
+      }
+    }
+  }
+
   std::string DoorUIDToId(const std::vector<Door>& doors, const std::size_t uid)
   {
     for (const auto& d : doors) {
@@ -23,10 +23,12 @@
 #define SOLEIL__WORLD_HPP_
 
 #include <functional>
+#include <map>
 #include <vector>
 
 #include "BoundingBox.hpp"
 #include "Draw.hpp"
+#include "Pvs.hpp"
 #include "types.hpp"
 
 namespace Soleil {
@@ -125,6 +127,27 @@ namespace Soleil {
     // Zone to frighten the player
     std::vector<DrawElement> ghosts;
     // All monsters
+    std::vector<PointLight> staticLights;
+    // Lights that never move, baked in the statics (see BakeStatics)
+    std::vector<ShapePtr> mergedWalls;
+    // Visible sides of the wall cubes, in world space (see MergeWalls)
+    std::vector<ShapePtr> bakedStatics;
+    // The elements merged in world space by BakeStatics, per material and
+    // region
+    BoxArray elementBounds;
+    BoxArray itemBounds;
+    BoxArray mergedWallBounds;
+    BoxArray bakedBounds;
+    // World space bounds of the above, same order (see ComputeBounds)
+    RenderQueue queue;
+    // Draw list of the current frame, kept to reuse its storage
+    std::vector<PointLight> sceneLights;
+    // All the lights of the frame while it only holds the visible ones, kept
+    // to reuse its storage (see RenderScene)
+    Pvs pvs;
+    // Cells visible from each cell of the current level
+    std::map<std::string, Pvs> pvsCache;
+    // Sets of the levels already visited, by level asset (kept on reset)
 
     World() {}
     World(const World&) = delete;
@@ -137,6 +160,12 @@ namespace Soleil {
   void InitializeWorldDoors(World& world, const std::string& assetName);
   void InitializeLevel(World& world, const std::string& level, Frame& frame,
                        Camera& camera, PopUp& caption);
+  void MergeWalls(World& world);
+  void BakeStatics(World& world);
+  void ComputeBounds(World& world);
+  void LoadPvs(World& world, const std::string& levelAsset,
+               const std::string& level);
+  void RemoveItem(World& world, const std::size_t id);
   std::string DoorUIDToId(const std::vector<Door>& doors,
                           const std::size_t        uid);
   Door* GetDoorByUID(std::vector<Door>& doors, const std::size_t uid);
@@ -56,6 +56,7 @@
 #include "OpenGLDataInstance.hpp"
 #include "Pristine.hpp"
 #include "SoundService.hpp"
+#include "StateCache.hpp"
 #include "WavefrontLoader.hpp"
 
 using namespace Soleil;
@@ -122,7 +123,7 @@ gui::EditorResources::EditorResources()
 {
   gridProgram.attachShader(Shader(GL_VERTEX_SHADER, "grid.vert"));
   gridProgram.attachShader(Shader(GL_FRAGMENT_SHADER, "grid.frag"));
-  glBindAttribLocation(gridProgram.program, 0, "position");
+  gridProgram.bindAttribLocation(0, "position");
   gridProgram.compile();
 
   gridMVP = gridProgram.getUniform("MVP");
@@ -359,6 +360,7 @@ namespace Soleil {
     struct Grid
     {
       gl::Buffer            buffer;
+      gl::Buffer            indexBuffer;
       glm::mat4             transformation;
       std::vector<GLushort> indices;
 
@@ -398,17 +400,23 @@ namespace Soleil {
           y++;
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+        gl::State().bindBuffer(GL_ARRAY_BUFFER, *buffer);
         glBufferData(GL_ARRAY_BUFFER, sizeof(points[0]) * points.size(),
                      points.data(), GL_STATIC_DRAW);
+        gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     sizeof(indices[0]) * indices.size(), indices.data(),
+                     GL_STATIC_DRAW);
+        gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         throwOnGlError();
       }
 
       void draw(const Frame& frame)
       {
         const GLsizei stride = sizeof(glm::vec3);
-        glUseProgram(editorResources->gridProgram.program);
-        glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+        gl::State().useProgram(editorResources->gridProgram.program);
+        gl::State().bindBuffer(GL_ARRAY_BUFFER, *buffer);
+        gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBuffer);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
                               (const GLvoid*)0);
         glEnableVertexAttribArray(0);
@@ -418,7 +426,8 @@ namespace Soleil {
           glm::value_ptr(frame.ViewProjection * transformation));
 
         glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_SHORT,
-                       indices.data());
+                       (const GLvoid*)0);
+        gl::State().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         throwOnGlError();
       }
     };
@@ -650,6 +659,7 @@ namespace Soleil {
           if (el.id == ptr) {
             el.transformation =
               glm::rotate(el.transformation, yaw, glm::vec3(0, 1, 0));
+            el.updateNormalMatrix();
             return true;
           }
         }
@@ -709,6 +719,8 @@ namespace Soleil {
       // GL resources initialization
       AssetService::Instance = std::make_shared<DesktopAssetService>("media/");
       SoundService::Instance = std::make_unique<DesktopSoundService>();
+
+      Program::BinaryCacheDirectory = "cache/";
       OpenGLDataInstance::Initialize();
       editorResources = std::make_unique<EditorResources>();
       OpenGLDataInstance::Instance().viewport = glm::vec2(width, height);
@@ -770,7 +782,7 @@ namespace Soleil {
       gl::RenderBuffer renderBuffer;
 
       {
-        glEnable(GL_DEPTH_TEST);
+        gl::State().enable(GL_DEPTH_TEST);
         gl::BindFrameBuffer bindFb(GL_FRAMEBUFFER, *frameBuffer);
         {
           gl::BindTexture BindTex(GL_TEXTURE_2D, *fbTexture);
@@ -841,27 +853,29 @@ namespace Soleil {
         frame.delta          = time - frame.time;
         frame.time           = time;
 
+        // ImGui renders with GL directly
+        gl::State().invalidate();
         {
           gl::BindFrameBuffer bindFB(GL_FRAMEBUFFER, *frameBuffer);
-          glEnable(GL_DEPTH_TEST);
+          gl::State().enable(GL_DEPTH_TEST);
           glViewport(0, 0, width, height);
           glClearColor(clear_color.x, clear_color.y, clear_color.z,
                        clear_color.w);
           glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-          glEnable(GL_DEPTH_TEST);
-          glDepthFunc(GL_LESS);
+          gl::State().enable(GL_DEPTH_TEST);
+          gl::State().depthFunc(GL_LESS);
 
 #if 1
           // TODO: FIXME: Actually It does not work without due to the
           // FrameBuffer
           // depth that does not work.
-          glEnable(GL_CULL_FACE);
-          glCullFace(GL_BACK);
+          gl::State().enable(GL_CULL_FACE);
+          gl::State().cullFace(GL_BACK);
 #endif
           // DrawImage(*OpenGLDataInstance::Instance().textures[0],
           // glm::mat4());
-          glEnable(GL_BLEND);
-          glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+          gl::State().enable(GL_BLEND);
+          gl::State().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
           cursorSelection.draw(world.shapes, frame);
           grid.draw(frame);
@@ -892,6 +906,11 @@ namespace Soleil {
           for (const auto b : debugBox) {
             DrawBoundingBox(b, frame, RGBA(1.0f, 0.5f, 0.2f, 0.5f));
           }
+          for (const PointLight& light : world.staticLights) {
+            DrawBoundingBox(
+              BoundingBox(light.position - 0.1f, light.position + 0.1f), frame,
+              RGBA(light.color, 0.8f));
+          }
         }
 
         ImGui_ImplGlfwGL3_NewFrame();
@@ -901,7 +920,7 @@ namespace Soleil {
     // Get the current cursor position (where your window is)
     ImVec2 pos = ImGui::GetCursorScreenPos();
 
-    GLuint tex = *OpenGLDataInstance::Instance().textures[0];
+    GLuint tex = *OpenGLDataInstance::Instance().textureTest;
 
     float w = 1920;
     float h = 1080;
@@ -1020,6 +1039,33 @@ namespace Soleil {
         ImGui::Checkbox("Render triggers", &doRenderTriggers);
         ImGui::End();
 
+        // Baked in the statics when the game loads the level
+        ImGui::Begin("Static lights");
+        if (ImGui::Button("Add at the camera")) {
+          world.staticLights.push_back(
+            {frame.cameraPosition, gval::cameraLight, .000010f, .00301f});
+        }
+        for (std::size_t i = 0; i < world.staticLights.size(); ++i) {
+          PointLight& light = world.staticLights[i];
+
+          ImGui::PushID(i);
+          ImGui::Separator();
+          ImGui::DragFloat3("Position", &light.position.x, 0.01f);
+          ImGui::ColorEdit3("Color", &light.color.r);
+          ImGui::DragFloat("Linear", &light.linear, 0.00001f, 0.0f, 1.0f,
+                           "%.5f");
+          ImGui::DragFloat("Quadratic", &light.quadratic, 0.0001f, 0.0f, 1.0f,
+                           "%.5f");
+          const bool remove = ImGui::Button("Remove");
+          ImGui::PopID();
+
+          if (remove) {
+            world.staticLights.erase(world.staticLights.begin() + i);
+            break;
+          }
+        }
+        ImGui::End();
+
         ImGui::Begin("Export");
         ImGui::InputText("input text", fileName, FILENAMESIZE);
         if (ImGui::Button("Save")) {
@@ -1037,6 +1083,10 @@ namespace Soleil {
           // # ghost:
           // 0 0.000 0.000 0.000 ...
           // ...
+          //
+          // # static lights (x y z r g b linear quadratic):
+          // 0.000 0.000 0.000 ...
+          // ...
 
           // II. Save
           // key true
@@ -1054,6 +1104,11 @@ namespace Soleil {
 
             outfile << "\n";
           }
+          for (const PointLight& light : world.staticLights) {
+            saveVec3(outfile, light.position);
+            saveVec3(outfile, light.color);
+            outfile << light.linear << " " << light.quadratic << "\n";
+          }
 
           // Save the doors:
           std::ofstream doorsfile("media/doors.ini");
@@ -1220,6 +1275,7 @@ namespace Soleil {
                      clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui::Render();
+        throwOnFrameGlError();
         glfwSwapBuffers(window);
       }
 
@@ -1286,8 +1342,12 @@ main(int argc, char* argv[])
       }
       return s;
     };
-    while ((c = getopt(argc, argv, "n:o:")) != -1) {
+    while ((c = getopt(argc, argv, "n:o:e")) != -1) {
       switch (c) {
+        case 'e': {
+          // Look for the GL errors after the calls
+          Soleil::gl::SetErrorCheck(Soleil::gl::ErrorCheck::PerCall);
+        } break;
         case 'n': {
           Soleil::gui::loadLevelOnStartup = remove_media(optarg);
         } break;
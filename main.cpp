@@ -28,6 +28,7 @@
 #include "DesktopAssetService.hpp"
 #include "DesktopSoundService.hpp"
 #include "OpenGLInclude.hpp"
+#include "Program.hpp"
 #include "Recorder.hpp"
 #include "Ruine.hpp"
 #include "stringutils.hpp"
@@ -234,12 +235,19 @@ main(int argc, char* argv[])
   AssetService::Instance = std::make_shared<DesktopAssetService>("media/");
   SoundService::Instance = std::make_unique<DesktopSoundService>();
 
+  // Linked programs kept between the launches
+  Program::BinaryCacheDirectory = "cache/";
+
   Recorder::state         = Recorder::DoNothing;
   Recorder::currentRecord = {0, 0, 0, 0, 0, 0, 0}; // TODO: constructor
   int         opt;
   std::string recordFileName = "last_record";
-  while ((opt = getopt(argc, argv, "r:p:P:")) != -1) {
+  while ((opt = getopt(argc, argv, "r:p:P:e")) != -1) {
     switch (opt) {
+      case 'e':
+        // Look for the GL errors after the calls
+        gl::SetErrorCheck(gl::ErrorCheck::PerCall);
+        break;
       case 'r':
         Recorder::state = Recorder::DoRecord;
         recordFileName  = optarg;
@@ -253,7 +261,7 @@ main(int argc, char* argv[])
         break;
       default:
         std::cout << "usage: " << argv[0]
-                  << " [-r record_file | -p play_file]\n";
+                  << " [-r record_file | -p play_file] [-e]\n";
         return 1;
         break;
     }
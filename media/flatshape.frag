@@ -1,5 +1,9 @@
 #version 100
 
+// Variants, defined by the program:
+// TEXTURED     The color comes from the diffuse map instead of ambiantColor
+// ALPHA_BLEND  Translucent, of the opacity and the alpha of the diffuse map
+
 precision lowp float;
 
 struct Material
@@ -9,14 +13,16 @@ struct Material
   vec3  emissiveColor;
   vec3  diffuseColor;
   vec3  specularColor;
+  float opacity;
 
   sampler2D diffuseMap;
 };
 
 uniform Material material;
 
-varying vec3 normal;
+#ifdef TEXTURED
 varying vec2 uv;
+#endif
 
 varying vec3 scatteredLight;
 varying vec3 reflectedLight;
@@ -24,14 +30,19 @@ varying vec3 reflectedLight;
 void
 main()
 {
-  vec3  materialColor = material.ambiantColor;
-  float alpha         = 1.0;
-  if (uv.x > -42.0) {
-    vec4 textureColor = texture2D(material.diffuseMap, uv);
-
-    materialColor = textureColor.rgb;
-    alpha         = textureColor.a;
-  }
+#ifdef TEXTURED
+  vec4 textureColor  = texture2D(material.diffuseMap, uv);
+  vec3 materialColor = textureColor.rgb;
+#else
+  vec3 materialColor = material.ambiantColor;
+#endif
+#if defined(ALPHA_BLEND) && defined(TEXTURED)
+  float alpha = material.opacity * textureColor.a;
+#elif defined(ALPHA_BLEND)
+  float alpha = material.opacity;
+#else
+  float alpha = 1.0;
+#endif
   vec3 rgb = min(materialColor * scatteredLight + reflectedLight, vec3(1.0));
 
   gl_FragColor = vec4(rgb, alpha);
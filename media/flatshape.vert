@@ -1,7 +1,21 @@
 #version 100
 
+// Variants, defined by the program:
+// LIGHT_COUNT  Number of point lights, from 0 to LightSet::Max
+// TEXTURED     The material has a diffuse map, uv is set
+// INSTANCED    The model matrix is the modelAttribute of the instance
+// BAKED_LIGHT  The colorAttribute holds the ambient and fixed lights, divided
+//              by LIGHTRANGE, the point lights are the moving ones
+
 precision lowp float;
 
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 0
+#endif
+
+const float UVRANGE    = 2.0; // VertexUvRange
+const float LIGHTRANGE = 2.0; // BakedLightRange
+
 struct PointLight
 {
   // TODO: Ambiant color and Specular color
@@ -18,29 +32,36 @@ struct Material
   vec3  emissiveColor;
   vec3  diffuseColor;
   vec3  specularColor;
+  float opacity;
 
   sampler2D diffuseMap;
 };
 
-const int MAXLIGHTS = 16; // TODO: In a header
-
 attribute vec4 positionAttribute;
 attribute vec3 normalAttribute;
 attribute vec4 colorAttribute;
-attribute vec2 uvAttribute;
+attribute vec2 uvAttribute; // Divided by UVRANGE
+#ifdef INSTANCED
+attribute mat4 modelAttribute; // Per instance, uses four locations
 
+uniform mat4 VPMatrix;
+#else
 uniform mat4 MVPMatrix;
 uniform mat4 MVMatrix;
 uniform mat3 NormalMatrix;
+#endif
 uniform vec3 EyeDirection;
 
 uniform Material material;
 uniform vec3 AmbiantLight;
-uniform int  numberOfLights;
-uniform PointLight pointLight[MAXLIGHTS];
+#if LIGHT_COUNT > 0
+uniform PointLight pointLight[LIGHT_COUNT];
+#endif
 
 varying vec4 color;
+#ifdef TEXTURED
 varying vec2 uv;
+#endif
 
 varying vec3 scatteredLight;
 varying vec3 reflectedLight;
@@ -48,17 +69,32 @@ varying vec3 reflectedLight;
 void
 main()
 {
-  const float ConstantAttenuation = 0.1; // TODO: If kept, put it in an uniform
-
-  scatteredLight = AmbiantLight;
+#ifdef BAKED_LIGHT
+  scatteredLight = colorAttribute.rgb * LIGHTRANGE;
+#else
+  scatteredLight = AmbiantLight + material.emissiveColor;
+#endif
   reflectedLight = vec3(0.0);
 
-  vec3 normal = normalize(NormalMatrix * normalAttribute);
-  for (int i = 0; i < numberOfLights; ++i) {
+#ifdef INSTANCED
+  // GLSL 100 has no inverse(), the instances are only rotated and uniformly
+  // scaled so the model matrix transforms the normals as well.
+  vec4 position = modelAttribute * positionAttribute;
+  mat3 rotation = mat3(modelAttribute[0].xyz, modelAttribute[1].xyz,
+                       modelAttribute[2].xyz);
+  vec3 normal   = normalize(rotation * normalAttribute);
+#else
+  vec4 position = MVMatrix * positionAttribute;
+  vec3 normal   = normalize(NormalMatrix * normalAttribute);
+#endif
+
+#if LIGHT_COUNT > 0
+  const float ConstantAttenuation = 0.1; // TODO: If kept, put it in an uniform
+
+  for (int i = 0; i < LIGHT_COUNT; ++i) {
     vec3 lightDirection;
 
-    lightDirection =
-      pointLight[i].position - vec3(MVMatrix * positionAttribute);
+    lightDirection      = pointLight[i].position - vec3(position);
     float lightDistance = length(lightDirection);
     lightDirection      = lightDirection / lightDistance;
     float attenuation =
@@ -67,7 +103,6 @@ main()
        pointLight[i].quadraticAttenuation * lightDistance * lightDistance);
     vec3 halfVector = normalize(lightDirection + EyeDirection);
 
-    // if (numberOfLights > 0) {
     float diffuse  = max(0.0, dot(normal, lightDirection));
     float specular = max(0.0, dot(normal, halfVector));
 
@@ -80,13 +115,14 @@ main()
       material.diffuseColor * pointLight[i].color * diffuse * attenuation;
     reflectedLight +=
       material.specularColor * pointLight[i].color * specular * attenuation;
-    // }
-    // else
-    //   scatteredLight +=
-    //   material.diffuseColor * pointLight[i].color  * attenuation;
   }
-  scatteredLight += material.emissiveColor;
-
-  uv          = uvAttribute;
+#endif
+#ifdef TEXTURED
+  uv = uvAttribute * UVRANGE;
+#endif
+#ifdef INSTANCED
+  gl_Position = VPMatrix * position;
+#else
   gl_Position = MVPMatrix * positionAttribute;
+#endif
 }
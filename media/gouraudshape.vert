@@ -11,12 +11,13 @@ struct PointLight
   float quadraticAttenuation;
 };
 
-const int MAXLIGHTS = 16; // TODO: In a header
+const int   MAXLIGHTS = 16;  // TODO: In a header
+const float UVRANGE   = 2.0; // VertexUvRange
 
 attribute vec4 positionAttribute;
 attribute vec3 normalAttribute;
 attribute vec4 colorAttribute;
-attribute vec2 uvAttribute;
+attribute vec2 uvAttribute; // Divided by UVRANGE
 
 uniform mat4 MVPMatrix;
 uniform mat4 MVMatrix;
@@ -54,6 +55,6 @@ main()
   }
 
   normal      = normalize(NormalMatrix * normalAttribute);
-  uv          = uvAttribute;
+  uv          = uvAttribute * UVRANGE;
   gl_Position = MVPMatrix * positionAttribute;
 }
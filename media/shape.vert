@@ -2,10 +2,12 @@
 
 precision lowp float;
 
+const float UVRANGE = 2.0; // VertexUvRange
+
 attribute vec4 positionAttribute;
 attribute vec3 normalAttribute;
 attribute vec4 colorAttribute;
-attribute vec2 uvAttribute;
+attribute vec2 uvAttribute; // Divided by UVRANGE
 
 uniform mat4 MVPMatrix;
 uniform mat4 MVMatrix;
@@ -22,6 +24,6 @@ main()
   color       = colorAttribute;
   normal      = normalize(NormalMatrix * normalAttribute);
   position    = MVMatrix * positionAttribute;
-  uv          = uvAttribute;
+  uv          = uvAttribute * UVRANGE;
   gl_Position = MVPMatrix * positionAttribute;
 }
@@ -5,11 +5,23 @@ precision lowp float;
 uniform sampler2D FontAtlas;
 uniform vec4 Color;
 
+#ifdef DISTANCE_FIELD
+// Half the width of the blended outline, in distance
+uniform mediump float Smoothing;
+#endif
+
 varying vec2 uv;
 
 void
 main()
 {
+#ifdef DISTANCE_FIELD
+  mediump float distance = texture2D(FontAtlas, uv).a;
+  float coverage = smoothstep(0.5 - Smoothing, 0.5 + Smoothing, distance);
+#else
+  float coverage = texture2D(FontAtlas, uv).a;
+#endif
+
   vec3 textColor = vec3(Color);
-  gl_FragColor   = vec4(textColor, texture2D(FontAtlas, uv).a * Color.a);
+  gl_FragColor   = vec4(textColor, coverage * Color.a);
 }
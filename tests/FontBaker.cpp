@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Font.hpp"
+
+using namespace Soleil;
+
+/**
+ * Rasterize the characters of the game with each TrueType font, as a distance
+ * field, and write the atlas next to it, as font-name.atlas. The game loads it
+ * instead of baking the font at start-up.
+ *
+ * Usage: ./fontBaker font-1.ttf [font-2.ttf [...]]
+ */
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " font-1.ttf [font-2.ttf [...]]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> arguments(argv + 1, argv + argc);
+
+  for (const auto& file : arguments) {
+    std::ifstream in(file, std::ios::binary);
+    if (in.is_open() == false) {
+      std::cerr << "Cannot read: " << file << "\n";
+      return 1;
+    }
+    const std::vector<std::uint8_t> ttf((std::istreambuf_iterator<char>(in)),
+                                        std::istreambuf_iterator<char>());
+
+    // The one loaded by Text::InitializeAtlasMap
+    const BakedFont font = BakedFont::Bake(GameCharMap, ttf, GameFontSize,
+                                           GameFontDistanceRange, 1024, 1024);
+
+    const std::string output = file.substr(0, file.rfind('.')) + ".atlas";
+    const std::vector<std::uint8_t> content = font.serialize();
+
+    std::ofstream out(output, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(content.data()), content.size());
+    std::cout << "File:" << file << "\t\t -> " << output << " ("
+              << content.size() << " bytes, " << font.glyphs.size()
+              << " glyphs)\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Ktx.hpp"
+
+// The game links its own copy in AssetService.cpp, not used here
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAILURE_USERMSG
+#include "stb_image.h"
+
+using namespace Soleil;
+
+/**
+ * Compress each image in ETC1 with its mip chain and write it next to it, as
+ * image-name.ktx. The game loads it instead of the PNG when the device reads
+ * ETC1. ETC1 has no alpha, the translucent images are left out.
+ *
+ * Usage: ./ktxBaker image-1.png [image-2.png [...]]
+ */
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " image-1.png [image-2.png [...]]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> arguments(argv + 1, argv + argc);
+
+  // Same rows order as the images loaded by the game (ImageAsset)
+  stbi_set_flip_vertically_on_load(1);
+  for (const auto& file : arguments) {
+    int           width    = 0;
+    int           height   = 0;
+    int           channels = 0;
+    std::uint8_t* image =
+      stbi_load(file.c_str(), &width, &height, &channels, 4);
+    if (image == nullptr) {
+      std::cerr << "Cannot read: " << file << " (" << stbi_failure_reason()
+                << ")\n";
+      return 1;
+    }
+
+    bool opaque = true;
+    for (int i = 0; i < width * height; ++i) {
+      if (image[i * 4 + 3] != 0xFF) opaque = false;
+    }
+    if (opaque == false) {
+      std::cout << "File:" << file << "\t\t -> skipped, not opaque\n";
+      stbi_image_free(image);
+      continue;
+    }
+
+    const KtxTexture ktx = KtxTexture::EncodeEtc1(image, width, height);
+    stbi_image_free(image);
+
+    const std::string output = file.substr(0, file.rfind('.')) + ".ktx";
+    const std::vector<std::uint8_t> content = ktx.serialize();
+
+    std::ofstream out(output, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(content.data()), content.size());
+    std::cout << "File:" << file << "\t\t -> " << output << " ("
+              << content.size() << " bytes, " << ktx.levels.size()
+              << " levels)\n";
+  }
+
+  return 0;
+}
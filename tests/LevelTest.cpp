@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mcut.hpp"
+
+#include "Culling.hpp"
+#include "LevelOptimizer.hpp"
+#include "Pvs.hpp"
+#include "Transform.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace Soleil;
+
+/**
+ * Same layout as wallcube.obj: 2x2x2 with the origin at the bottom
+ */
+static std::vector<SubShape>
+MakeWallCube()
+{
+  SubShape sub;
+
+  for (int axis = 0; axis < 3; ++axis) {
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+
+    for (int positive = 0; positive < 2; ++positive) {
+      const GLushort base = sub.vertices.size();
+      const float    corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+      glm::vec3      normal(0.0f);
+      normal[axis] = positive ? 1.0f : -1.0f;
+
+      for (const auto& corner : corners) {
+        glm::vec4 position(0.0f, 0.0f, 0.0f, 1.0f);
+        position[axis] = positive ? 1.0f : -1.0f;
+        position[u]    = corner[0] * 2.0f - 1.0f;
+        position[v]    = corner[1] * 2.0f - 1.0f;
+        position.y += 1.0f;
+
+        sub.vertices.emplace_back(position, normal, glm::vec4(1.0f),
+                                  glm::vec2(corner[0], corner[1]));
+      }
+
+      const GLushort order[2][6] = {{0, 3, 2, 2, 1, 0}, {0, 1, 2, 2, 3, 0}};
+      for (GLushort o : order[positive]) {
+        sub.indices.push_back(base + o);
+      }
+    }
+  }
+  return {sub};
+}
+
+static std::size_t
+CountQuads(const std::vector<SubShape>& subShapes)
+{
+  std::size_t indices = 0;
+  for (const auto& sub : subShapes) indices += sub.indices.size();
+
+  return indices / 6;
+}
+
+static void
+ModelIsACube()
+{
+  const auto subShapes = MakeWallCube();
+  CubeModel  model;
+
+  mcut::assertTrue(CubeModel::FromSubShapes(subShapes, model));
+  mcut::assertEquals(glm::vec3(2.0f), model.size());
+
+  // A single side is not a cube
+  std::vector<SubShape> side = subShapes;
+  side[0].indices.resize(6);
+  mcut::assertFalse(CubeModel::FromSubShapes(side, model));
+}
+
+static void
+CellsOnTheGrid()
+{
+  const auto subShapes = MakeWallCube();
+  CubeModel  model;
+  glm::ivec3 cell;
+
+  CubeModel::FromSubShapes(subShapes, model);
+  mcut::assertTrue(GridCell(
+    glm::translate(glm::mat4(), glm::vec3(4.0f, 0.0f, -2.0f)), model, cell));
+  mcut::assertTrue(cell == glm::ivec3(2, 0, -1));
+
+  mcut::assertFalse(GridCell(
+    glm::translate(glm::mat4(), glm::vec3(1.0f, 0.0f, 0.0f)), model, cell));
+  mcut::assertFalse(
+    GridCell(glm::rotate(glm::mat4(), 0.5f, glm::vec3(0, 1, 0)), model, cell));
+}
+
+static void
+HiddenSidesAreRemoved()
+{
+  const auto subShapes = MakeWallCube();
+  CubeModel  model;
+  CubeModel::FromSubShapes(subShapes, model);
+
+  // Two cubes far apart keep their 12 sides
+  mcut::assertEquals(12u, CountQuads(MergeGridCubes(
+                            {glm::ivec3(0), glm::ivec3(2, 0, 0)}, model,
+                            subShapes)));
+
+  // A row of three: 4 long sides and 2 ends
+  mcut::assertEquals(
+    6u, CountQuads(MergeGridCubes({glm::ivec3(0), glm::ivec3(1, 0, 0),
+                                   glm::ivec3(2, 0, 0)},
+                                  model, subShapes)));
+
+  // A 2x2 block is a single box as well
+  mcut::assertEquals(
+    6u,
+    CountQuads(MergeGridCubes({glm::ivec3(0), glm::ivec3(1, 0, 0),
+                               glm::ivec3(0, 0, 1), glm::ivec3(1, 0, 1)},
+                              model, subShapes)));
+}
+
+static void
+MergedSidesRepeatTheTexture()
+{
+  const auto subShapes = MakeWallCube();
+  CubeModel  model;
+  CubeModel::FromSubShapes(subShapes, model);
+
+  const auto merged = MergeGridCubes(
+    {glm::ivec3(0), glm::ivec3(1, 0, 0), glm::ivec3(2, 0, 0)}, model,
+    subShapes);
+
+  float maxU = 0.0f;
+  for (const auto& vertex : merged[0].vertices) {
+    if (vertex.normal == glm::vec3(0, 1, 0)) {
+      maxU = glm::max(maxU, glm::max(vertex.uv.x, vertex.uv.y));
+      mcut::assertTrue(vertex.position.y == 2.0f);
+    }
+  }
+  mcut::assertEquals(3.0f, maxU);
+}
+
+static void
+CollisionBoxesAreMerged()
+{
+  std::vector<BoundingBox> boxes;
+
+  // A L shaped wall
+  for (int x = 0; x < 3; ++x) {
+    boxes.emplace_back(glm::vec3(x * 2 - 1, 0, -1), glm::vec3(x * 2 + 1, 2, 1));
+  }
+  boxes.emplace_back(glm::vec3(-1, 0, 1), glm::vec3(1, 2, 3));
+  MergeBoundingBoxes(boxes);
+  mcut::assertEquals(2u, boxes.size());
+
+  // A 2x2 square
+  boxes.clear();
+  for (int x = 0; x < 2; ++x) {
+    for (int z = 0; z < 2; ++z) {
+      boxes.emplace_back(glm::vec3(x * 2 - 1, 0, z * 2 - 1),
+                         glm::vec3(x * 2 + 1, 2, z * 2 + 1));
+    }
+  }
+  MergeBoundingBoxes(boxes);
+  mcut::assertEquals(1u, boxes.size());
+  mcut::assertEquals(glm::vec3(-1, 0, -1), boxes[0].getMin());
+  mcut::assertEquals(glm::vec3(3, 2, 3), boxes[0].getMax());
+}
+
+static void
+BoxesOutsideTheFrustumAreCulled()
+{
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.0f, 0.0f),
+                                     glm::vec3(0.0f, 1.0f, -1.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+  const glm::mat4 projection =
+    glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 50.0f);
+  const Frustum frustum = Frustum::FromViewProjection(projection * view);
+
+  BoxArray boxes;
+  // Ahead, behind, beyond the far plane and around the camera
+  boxes.push(BoundingBox(glm::vec3(-1, 0, -5), glm::vec3(1, 2, -3)));
+  boxes.push(BoundingBox(glm::vec3(-1, 0, 3), glm::vec3(1, 2, 5)));
+  boxes.push(BoundingBox(glm::vec3(-1, 0, -80), glm::vec3(1, 2, -60)));
+  boxes.push(BoundingBox(glm::vec3(-1, 0, -1), glm::vec3(1, 2, 1)));
+
+  std::vector<std::uint8_t> visible;
+  mcut::assertEquals(2u, boxes.cull(frustum, visible));
+  mcut::assertEquals(1, visible[0]);
+  mcut::assertEquals(0, visible[1]);
+  mcut::assertEquals(0, visible[2]);
+  mcut::assertEquals(1, visible[3]);
+}
+
+static void
+CellsBehindAWallAreHidden()
+{
+  // Two rooms split by a wall along z, with a door at z = 4
+  std::vector<std::uint8_t> occluders(5 * 5, 0);
+  for (int z = 0; z < 5; ++z) {
+    if (z != 4) occluders[z * 5 + 2] = 1;
+  }
+  const Pvs pvs =
+    Pvs::Compute(glm::vec2(0.0f), 2.0f, 5, 5, occluders, 50.0f);
+
+  const int left  = pvs.cellAt(glm::vec3(1.0f, 1.0f, 1.0f));
+  const int right = pvs.cellAt(glm::vec3(9.0f, 1.0f, 1.0f));
+  const int door  = pvs.cellAt(glm::vec3(5.0f, 1.0f, 9.0f));
+  mcut::assertEquals(0, left);
+  mcut::assertEquals(-1, pvs.cellAt(glm::vec3(-1.0f, 1.0f, 1.0f)));
+  mcut::assertFalse(pvs.isVisible(left, right));
+  mcut::assertTrue(pvs.isVisible(left, pvs.cellAt(glm::vec3(5, 1, 1))));
+  mcut::assertTrue(pvs.isVisible(door, right));
+
+  // The set survives its text form, tied to the level it was made from
+  Pvs read;
+  mcut::assertTrue(Pvs::Deserialize(pvs.serialize(42u), 42u, read));
+  mcut::assertFalse(read.isVisible(left, right));
+  mcut::assertTrue(read.isVisible(door, left));
+  mcut::assertFalse(Pvs::Deserialize(pvs.serialize(42u), 43u, read));
+
+  BoxArray boxes;
+  boxes.push(BoundingBox(glm::vec3(8, 0, 0), glm::vec3(10, 2, 2)));
+  boxes.push(BoundingBox(glm::vec3(0, 0, 2), glm::vec3(2, 2, 4)));
+  std::vector<std::uint8_t> visible(2, 1);
+  pvs.cull(glm::vec3(1.0f), boxes, visible);
+  mcut::assertEquals(0, visible[0]);
+  mcut::assertEquals(1, visible[1]);
+}
+
+static void
+TheStrongestLightsAreSelected()
+{
+  const BoundingBox       wall(glm::vec3(0, 0, 0), glm::vec3(2, 2, 2));
+  std::vector<PointLight> lights;
+
+  // One far away, then five at increasing distances from the wall
+  lights.push_back({glm::vec3(100, 1, 1), glm::vec3(1.0f), 0.7f, 0.2f});
+  for (int i = 0; i < 5; ++i) {
+    lights.push_back(
+      {glm::vec3(3 + i, 1, 1), glm::vec3(1.0f), 0.7f, 0.2f});
+  }
+
+  const LightSet set = LightSet::Select(wall, lights, 1.0f / 255.0f);
+  mcut::assertEquals(LightSet::Max, set.size());
+  for (int i = 0; i < LightSet::Max; ++i) {
+    mcut::assertEquals(i + 1, set[i]);
+  }
+
+  // A light inside the box is the strongest, the dim one is left out
+  lights.push_back({glm::vec3(1, 1, 1), glm::vec3(1.0f), 0.7f, 0.2f});
+  lights.push_back({glm::vec3(4, 1, 1), glm::vec3(0.001f), 0.7f, 0.2f});
+  const LightSet inside = LightSet::Select(wall, lights, 1.0f / 255.0f);
+  mcut::assertEquals(6, inside[LightSet::Max - 1]);
+  mcut::assertTrue(inside != set);
+
+  mcut::assertEquals(0, LightSet().size());
+  mcut::assertEquals(
+    0, LightSet::Select(wall, {lights[0]}, 1.0f / 255.0f).size());
+}
+
+static void
+StaticLightIsBaked()
+{
+  SubShape floor;
+  floor.material.diffuseColor  = glm::vec3(0.5f);
+  floor.material.emissiveColor = glm::vec3(0.1f);
+  floor.vertices.emplace_back(glm::vec4(0, 0, 0, 1), glm::vec3(0, 1, 0));
+  floor.vertices.emplace_back(glm::vec4(0, 0, 4, 1), glm::vec3(0, 1, 0));
+
+  // Right above the first vertex, at 2 units
+  const PointLight light = {glm::vec3(0, 2, 0), glm::vec3(1.0f), 0.7f, 0.2f};
+  BakeLighting(floor, glm::vec3(0.2f), {light});
+
+  const float direct = 0.5f * LightAttenuation(light, 2.0f);
+  const float distance = glm::sqrt(20.0f);
+  const float slanted =
+    0.5f * (2.0f / distance) * LightAttenuation(light, distance);
+  mcut::assertTrue(
+    glm::abs(floor.vertices[0].color.r * BakedLightRange - (0.3f + direct)) <
+    1e-4f);
+  mcut::assertTrue(
+    glm::abs(floor.vertices[1].color.g * BakedLightRange - (0.3f + slanted)) <
+    1e-4f);
+  mcut::assertEquals(1.0f, floor.vertices[0].color.a);
+  mcut::assertTrue(floor.material.features & MaterialFeature::BakedLight);
+}
+
+static void
+MatricesAreComputedInBatch()
+{
+  const glm::mat4 viewProjection =
+    glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 50.0f) *
+    glm::lookAt(glm::vec3(1, 2, 3), glm::vec3(0), glm::vec3(0, 1, 0));
+
+  std::vector<glm::mat4> models;
+  for (int i = 0; i < 5; ++i) {
+    models.push_back(glm::scale(
+      glm::rotate(glm::translate(glm::mat4(), glm::vec3(i, -i, 2 * i)),
+                  0.3f * i, glm::vec3(0, 1, 0)),
+      glm::vec3(1.0f + i, 1.0f, 0.5f)));
+  }
+
+  std::vector<glm::mat4> mvps(models.size());
+  MultiplyMatrices(viewProjection, models.data(), mvps.data(), models.size());
+  for (std::size_t i = 0; i < models.size(); ++i) {
+    const glm::mat4 expected = viewProjection * models[i];
+    const glm::mat3 normal =
+      glm::transpose(glm::inverse(glm::mat3(models[i])));
+    const glm::mat3 actual = NormalMatrix(models[i]);
+
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        mcut::assertTrue(glm::abs(expected[c][r] - mvps[i][c][r]) < 1e-4f);
+        if (c < 3 && r < 3)
+          mcut::assertTrue(glm::abs(normal[c][r] - actual[c][r]) < 1e-4f);
+      }
+    }
+  }
+}
+
+int
+main(int, char* [])
+{
+  int failed = 0;
+
+  mcut::TestSuite cubes("Grid cubes");
+  cubes.add(ModelIsACube);
+  cubes.add(CellsOnTheGrid);
+  cubes.add(HiddenSidesAreRemoved);
+  cubes.add(MergedSidesRepeatTheTexture);
+  failed += cubes.run();
+
+  mcut::TestSuite boxes("Collision boxes");
+  boxes.add(CollisionBoxesAreMerged);
+  failed += boxes.run();
+
+  mcut::TestSuite culling("Culling");
+  culling.add(BoxesOutsideTheFrustumAreCulled);
+  culling.add(CellsBehindAWallAreHidden);
+  culling.add(TheStrongestLightsAreSelected);
+  culling.add(StaticLightIsBaked);
+  failed += culling.run();
+
+  mcut::TestSuite transforms("Transforms");
+  transforms.add(MatricesAreComputedInBatch);
+  failed += transforms.run();
+
+  // Registered in ctest
+  return failed;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Pvs.hpp"
+#include "types.hpp"
+
+using namespace Soleil;
+
+/**
+ * Compute the potentially visible set of each level and write it next to it,
+ * as level-name.pvs, so the game does not compute it when loading the level.
+ *
+ * Usage: ./pvsBaker file-1.level [file-2.level [...]]
+ */
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " file-1.level [file-2.level [...]]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> arguments(argv + 1, argv + argc);
+
+  for (const auto& file : arguments) {
+    std::ifstream     in(file);
+    std::stringstream level;
+    level << in.rdbuf();
+    if (!in) {
+      std::cerr << "Cannot read: " << file << "\n";
+      return 1;
+    }
+
+    const Pvs pvs = Pvs::FromLevel(level.str(), gval::pvsCellSize,
+                                   gval::pvsMaxDistance);
+    const std::string output = file.substr(0, file.rfind('.')) + ".pvs";
+
+    std::ofstream out(output);
+    out << pvs.serialize(Pvs::Hash(level.str()));
+    std::cout << "File:" << file << "\t\t -> " << output << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2017  Florian GOLESTIN
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "mcut.hpp"
+
+#include "Font.hpp"
+#include "Text.hpp"
+#include "stringutils.hpp"
+
+#include <map>
+
+#define SOLEIL__DO_BENCHMARK 1
+
+#if SOLEIL__DO_BENCHMARK
+// Benchmark of the glyph table replacing the std::map
+#include <benchmark/benchmark.h>
+#endif
+
+using namespace Soleil;
+using namespace Soleil::Text;
+
+// Texts of Ruine.cpp
+static const std::wstring Dialogues[] = {
+  L"TU ES MAINTENANT ENFERME DANS CETTE RUINE",
+  L"APPUIE SUR TON ECRAN POUR AVANCER",
+  L"DEPLACE TON DOIGT VERS LA GAUCHE OU LA DROITE POUR TOURNER. APPUIE "
+  L"DEUX FOIS POUR UN DEMI-TOUR",
+  L"TROUVE LA CLEF POUR SORTIR DE CE LIEU",
+  L"BON COURAGE MON AMI ET FAIS ATTENTION A MES CONGENERES",
+  L"      RUINE\n       -----\n\n\nPar Florian "
+  L"GOLESTIN\n\n\n   REMERCIEMENTS\n    "
+  L"---------------\nAntoine TALLON\nJulien GERBIER\nHoracio "
+  L"GOLDBERG"};
+
+/**
+ * Glyphs of the game characters, each one a different size
+ */
+static FontAtlas
+MakeAtlas(void)
+{
+  FontAtlas atlas;
+  atlas.verticalAdvance = 0.1f;
+  atlas.distanceRange   = 0.0f;
+  atlas.pixelsPerTexel  = 1.0f;
+
+  float size = 0.01f;
+  for (const wchar_t c : GameCharMap) {
+    atlas.glyphs.insert(c, GlyphSlot(glm::vec2(0.0f), glm::vec2(0.1f),
+                                     glm::vec2(0.0f), glm::vec2(size), size));
+    size += 0.001f;
+  }
+  return atlas;
+}
+
+static void
+GlyphsAreFound()
+{
+  FontAtlas atlas = MakeAtlas();
+  atlas.glyphs.insert(L'\x263A', GlyphSlot(glm::vec2(0.0f), glm::vec2(0.0f),
+                                           glm::vec2(0.0f), glm::vec2(0.0f),
+                                           42.0f));
+
+  mcut::assertEquals(GameCharMap.size() + 1, atlas.glyphs.size());
+  mcut::assertEquals(0.01f, atlas.glyphs.at(L'A').advance);
+  mcut::assertTrue(atlas.glyphs.find(L'À') != nullptr);
+  mcut::assertEquals(42.0f, atlas.glyphs.at(L'\x263A').advance);
+  mcut::assertTrue(atlas.glyphs.find(L'#') == nullptr);
+  mcut::assertTrue(atlas.glyphs.find(L'\x263B') == nullptr);
+}
+
+static void
+TextIsLaidOutInQuads()
+{
+  const FontAtlas         atlas = MakeAtlas();
+  std::vector<CharVertex> vertices;
+
+  LayoutText(L"AB\nA", atlas, 2.0f, vertices);
+  mcut::assertEquals(12u, vertices.size());
+
+  // B after the advance of A, the second A on the next line
+  mcut::assertEquals(glm::vec3(0.02f, 0.0f, 0.0f), vertices[4].position);
+  mcut::assertEquals(glm::vec3(0.0f, -0.2f, 0.0f), vertices[8].position);
+}
+
+static void
+TextIsWrappedAtSpaces()
+{
+  const FontAtlas          atlas = MakeAtlas();
+  std::vector<CharVertex>  vertices;
+  std::vector<LineMetrics> lines;
+
+  // Advances of A: 0.01, B: 0.011, space: 0.073
+  LayoutWrappedText(L"AB AB\nAAAA", atlas, 1.0f, 0.025f, vertices, &lines);
+  mcut::assertEquals(4u, lines.size());
+  mcut::assertEquals(32u, vertices.size());
+
+  // The space at the break is dropped
+  mcut::assertEquals(2u, lines[0].quads);
+  mcut::assertEquals(2u, lines[1].firstQuad);
+  mcut::assertTrue(glm::abs(lines[0].width - 0.021f) < 1e-6f);
+  mcut::assertEquals(-0.1f, lines[1].baseline);
+  mcut::assertEquals(glm::vec3(0.0f, -0.1f, 0.0f), vertices[8].position);
+
+  // A word larger than the line is broken
+  mcut::assertEquals(3u, lines[2].quads);
+  mcut::assertEquals(1u, lines[3].quads);
+}
+
+static void
+LayoutsAreCached()
+{
+  const FontAtlas atlas = MakeAtlas();
+  LayoutCache     cache;
+
+  const TextQuads label = cache.get(L"BUTIN: 5", atlas, 1.0f, 0.0f);
+  mcut::assertTrue(label == cache.get(L"BUTIN: 5", atlas, 1.0f, 0.0f));
+  mcut::assertTrue(label != cache.get(L"BUTIN: 5", atlas, 2.0f, 0.0f));
+  mcut::assertTrue(label != cache.get(L"BUTIN: 5", atlas, 1.0f, 0.05f));
+  mcut::assertEquals(1u, cache.getStats().hits);
+
+  // The least recently used is dropped
+  for (std::size_t i = 0; i < LayoutCache::Capacity; ++i)
+    cache.get(toWString(i), atlas, 1.0f, 0.0f);
+  mcut::assertTrue(label != cache.get(L"BUTIN: 5", atlas, 1.0f, 0.0f));
+  mcut::assertEquals(1u, cache.getStats().hits);
+}
+
+#if SOLEIL__DO_BENCHMARK
+static void
+BM_MapLookup(benchmark::State& state)
+{
+  const FontAtlas                    atlas = MakeAtlas();
+  std::map<wchar_t, const GlyphSlot> glyphs;
+  for (const wchar_t c : GameCharMap)
+    glyphs.emplace(c, atlas.glyphs.at(c));
+
+  while (state.KeepRunning()) {
+    float advance = 0.0f;
+    for (const auto& text : Dialogues) {
+      for (const wchar_t c : text) {
+        if (c == L'\n') continue;
+        if (glyphs.find(c) == glyphs.end()) state.SkipWithError("No glyph");
+        advance += glyphs.at(c).advance;
+      }
+    }
+    benchmark::DoNotOptimize(advance);
+  }
+}
+BENCHMARK(BM_MapLookup);
+
+static void
+BM_GlyphTableLookup(benchmark::State& state)
+{
+  const FontAtlas atlas = MakeAtlas();
+
+  while (state.KeepRunning()) {
+    float advance = 0.0f;
+    for (const auto& text : Dialogues) {
+      for (const wchar_t c : text) {
+        if (c == L'\n') continue;
+        advance += atlas.glyphs.at(c).advance;
+      }
+    }
+    benchmark::DoNotOptimize(advance);
+  }
+}
+BENCHMARK(BM_GlyphTableLookup);
+
+static void
+BM_LayoutText(benchmark::State& state)
+{
+  const FontAtlas         atlas = MakeAtlas();
+  std::vector<CharVertex> vertices;
+
+  while (state.KeepRunning()) {
+    for (const auto& text : Dialogues) {
+      vertices.clear();
+      LayoutText(text, atlas, 1.0f, vertices);
+    }
+    benchmark::DoNotOptimize(vertices.data());
+  }
+}
+BENCHMARK(BM_LayoutText);
+
+static void
+BM_LayoutWrappedText(benchmark::State& state)
+{
+  const FontAtlas         atlas = MakeAtlas();
+  std::vector<CharVertex> vertices;
+
+  // A long localized paragraph
+  std::wstring paragraph;
+  for (int i = 0; i < state.range(0); ++i) paragraph += Dialogues[2] + L" ";
+
+  while (state.KeepRunning()) {
+    vertices.clear();
+    LayoutWrappedText(paragraph, atlas, 1.0f, 1.0f, vertices);
+    benchmark::DoNotOptimize(vertices.data());
+  }
+  state.SetComplexityN(paragraph.size());
+}
+BENCHMARK(BM_LayoutWrappedText)->Range(1, 64)->Complexity();
+
+static void
+BM_LayoutCache(benchmark::State& state)
+{
+  const FontAtlas atlas = MakeAtlas();
+  LayoutCache     cache;
+
+  while (state.KeepRunning()) {
+    for (const auto& text : Dialogues) {
+      benchmark::DoNotOptimize(cache.get(text, atlas, 1.0f, 0.0f));
+    }
+  }
+}
+BENCHMARK(BM_LayoutCache);
+#endif
+
+int
+main(int argc, char* argv[])
+{
+  mcut::TestSuite glyphs("Glyphs");
+  glyphs.add(GlyphsAreFound);
+  glyphs.add(TextIsLaidOutInQuads);
+  glyphs.add(TextIsWrappedAtSpaces);
+  glyphs.add(LayoutsAreCached);
+  const int failed = glyphs.run();
+
+#if SOLEIL__DO_BENCHMARK
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+#else
+  (void)argc;
+  (void)argv;
+#endif
+
+  // Registered in ctest
+  return failed;
+}
@@ -191,6 +191,15 @@ namespace Soleil {
     static const float     textLabelSize = 0.35f;
     static const Color     textLabelColor(0.8f);
     static const Timer     timeBeforeWhisper(6000);
+    static const bool      mergeWalls     = true;
+    static const bool      bakeStatics    = true;
+    static const float     bakeRegionSize = 16.0f;
+    static const bool      usePvs         = true;
+    static const float     pvsCellSize    = 2.0f;
+    static const float     pvsMaxDistance = 50.0f;
+    static const int       pvsLightMargin = 2; // Cells a light may reach
+    // Lights bringing less to a draw are not sent, a step of 8 bits colors
+    static const float lightInfluenceMin = 1.0f / 255.0f;
 
 #if 0 // Temp
     static GLuint bezierTex;